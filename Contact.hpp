@@ -0,0 +1,307 @@
+#ifndef _CONTACT_HPP
+#define _CONTACT_HPP
+
+#include <glm/glm.hpp>
+
+#include <stddef.h>
+#include <vector>
+
+#include "SimdMath.hpp"
+
+// the ground and contacts against it
+
+// a heightfield over x/z: samples on a square grid starting at origin, interpolated bilinearly in between
+// and clamped to the edge outside. with no samples at all it's a flat plane at baseHeight
+class Heightfield {
+public:
+    float baseHeight = 0.0f; // added to every sample
+    glm::vec2 origin = glm::vec2(0.0f);
+    float spacing = 1.0f;
+    int columns = 0; // along x
+    int rows = 0; // along z
+    std::vector<float> samples; // [row * columns + column]
+
+    Heightfield(float baseHeight = 0.0f) : baseHeight(baseHeight) {}
+
+    float height(float x, float z) const {
+        if (samples.empty()) {
+            return baseHeight;
+        }
+        int c, r;
+        float tx, tz;
+        cell(x, z, c, r, tx, tz);
+        float h00 = sample(c, r), h10 = sample(c + 1, r);
+        float h01 = sample(c, r + 1), h11 = sample(c + 1, r + 1);
+        float h0 = h00 + (h10 - h00) * tx;
+        float h1 = h01 + (h11 - h01) * tx;
+        return baseHeight + h0 + (h1 - h0) * tz;
+    }
+
+    // the surface normal, straight up for the flat plane
+    glm::vec3 normal(float x, float z) const {
+        if (samples.empty()) {
+            return glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+        int c, r;
+        float tx, tz;
+        cell(x, z, c, r, tx, tz);
+        float h00 = sample(c, r), h10 = sample(c + 1, r);
+        float h01 = sample(c, r + 1), h11 = sample(c + 1, r + 1);
+        // slopes of the bilinear patch
+        float dx = ((h10 - h00) * (1.0f - tz) + (h11 - h01) * tz) / spacing;
+        float dz = ((h01 - h00) * (1.0f - tx) + (h11 - h10) * tx) / spacing;
+        return glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+    }
+
+private:
+    float sample(int c, int r) const {
+        c = glm::clamp(c, 0, columns - 1);
+        r = glm::clamp(r, 0, rows - 1);
+        return samples[(size_t)r * columns + c];
+    }
+
+    void cell(float x, float z, int& c, int& r, float& tx, float& tz) const {
+        float fx = glm::clamp((x - origin.x) / spacing, 0.0f, (float)glm::max(columns - 1, 0));
+        float fz = glm::clamp((z - origin.y) / spacing, 0.0f, (float)glm::max(rows - 1, 0));
+        c = (int)fx;
+        r = (int)fz;
+        tx = fx - c;
+        tz = fz - r;
+    }
+};
+
+// linear and angular velocities of many rigid bodies, per component so several bodies fit in one register
+struct BodyVelocities {
+    std::vector<float> vx, vy, vz;
+    std::vector<float> wx, wy, wz;
+
+    void resize(size_t count) {
+        for (std::vector<float>* c : {&vx, &vy, &vz, &wx, &wy, &wz}) c->assign(count, 0.0f);
+    }
+
+    glm::vec3 linear(size_t i) const { return glm::vec3(vx[i], vy[i], vz[i]); }
+    glm::vec3 angular(size_t i) const { return glm::vec3(wx[i], wy[i], wz[i]); }
+
+    void setLinear(size_t i, glm::vec3 v) { vx[i] = v.x; vy[i] = v.y; vz[i] = v.z; }
+    void setAngular(size_t i, glm::vec3 w) { wx[i] = w.x; wy[i] = w.y; wz[i] = w.z; }
+};
+
+// contacts between rigid bodies and the static ground, resolved with sequential impulses (projected gauss
+// seidel on the contact velocities) with coulomb friction in two fixed directions per contact.
+//
+// every step: begin(), addContact() for every touching point, then solve(). contact k of each body goes in
+// slot k, stored [slot * numBodies + body], so one slot of consecutive bodies sits side by side in memory
+// and the solver can do 8 (avx2) or 4 (sse) bodies per instruction. the bodies of one slot are all
+// different, so nothing in a group fights over a velocity, and going slot by slot is still gauss seidel
+// for each body. bodies with fewer contacts than the busiest one get empty contacts, with no mass and no
+// effect.
+//
+// each body has a fixed set of candidate points (box corners, say) named by id. the impulses a candidate
+// ended a step with are applied up front the next step if it's still touching (warm starting), so resting
+// contacts start out almost solved and a few iterations are plenty
+class ContactSolver {
+public:
+    int iterations = 6;
+    float friction = 0.8f;
+    float baumgarte = 0.2f; // fraction of the penetration pushed out per step
+    float slop = 0.01f; // penetration left alone, so resting contacts don't jitter
+
+    ContactSolver(int numBodies = 0, int candidatesPerBody = 0) : numBodies(numBodies), candidatesPerBody(candidatesPerBody) {
+        size_t slots = (size_t)numBodies * candidatesPerBody;
+        for (int d = 0; d < 3; d++) {
+            row& r = rows[d];
+            for (std::vector<float>* c : {&r.dirX, &r.dirY, &r.dirZ, &r.armX, &r.armY, &r.armZ,
+                                          &r.angX, &r.angY, &r.angZ, &r.mass, &r.bias, &r.lambda}) {
+                c->assign(slots, 0.0f);
+            }
+            warmLambda[d].assign(slots, 0.0f);
+        }
+        slotCandidate.assign(slots, -1);
+        contactCount.assign(numBodies, 0);
+        warmStarted.assign(slots, 0);
+    }
+
+    // contacts found in the last step
+    int totalContacts = 0;
+
+    void begin() {
+        for (int b = 0; b < numBodies; b++) contactCount[b] = 0;
+    }
+
+    // a candidate point of a body touching the ground, or close enough that it could this step. arm is from
+    // the body's center of mass to the point, depth is how far it's below the surface (negative while it's
+    // still above it), and pointVelocity is how fast the point moves on its own relative to the body, like a
+    // foot pushing backwards, all in world space. invInertia is the body's inverse inertia in world space
+    void addContact(int body, int candidate, glm::vec3 arm, glm::vec3 normal, float depth, glm::vec3 pointVelocity,
+                    float invMass, const glm::mat3& invInertia, float dt) {
+        int slot = contactCount[body]++;
+        size_t k = (size_t)slot * numBodies + body;
+        slotCandidate[k] = candidate;
+
+        // friction directions that don't depend on the body, so the warm started impulses stay meaningful
+        glm::vec3 t1 = glm::vec3(1.0f, 0.0f, 0.0f) - normal * normal.x;
+        if (glm::dot(t1, t1) < 1e-6f) t1 = glm::vec3(0.0f, 0.0f, 1.0f) - normal * normal.z;
+        t1 = glm::normalize(t1);
+        glm::vec3 t2 = glm::cross(normal, t1);
+        glm::vec3 dirs[3] = {normal, t1, t2};
+
+        size_t c = (size_t)body * candidatesPerBody + candidate;
+        for (int d = 0; d < 3; d++) {
+            row& r = rows[d];
+            glm::vec3 armCross = glm::cross(arm, dirs[d]);
+            glm::vec3 ang = invInertia * armCross;
+            r.dirX[k] = dirs[d].x; r.dirY[k] = dirs[d].y; r.dirZ[k] = dirs[d].z;
+            r.armX[k] = armCross.x; r.armY[k] = armCross.y; r.armZ[k] = armCross.z;
+            r.angX[k] = ang.x; r.angY[k] = ang.y; r.angZ[k] = ang.z;
+            r.mass[k] = 1.0f / (invMass + glm::dot(armCross, ang));
+            // the velocity the point should end up with along this direction, sign flipped
+            r.bias[k] = glm::dot(pointVelocity, dirs[d]);
+            r.lambda[k] = warmStarted[c] ? warmLambda[d][c] : 0.0f;
+        }
+        // push out part of any penetration, and let points that are still above the ground close the gap
+        // (speculative contact) but not go through
+        rows[0].bias[k] += (glm::max(-depth, 0.0f) - baumgarte * glm::max(depth - slop, 0.0f)) / dt;
+    }
+
+    // resolves this step's contacts, changing velocities. invMass is per body
+    void solve(BodyVelocities& velocities, const float* invMass) {
+        int numSlots = 0;
+        totalContacts = 0;
+        for (int b = 0; b < numBodies; b++) {
+            numSlots = glm::max(numSlots, contactCount[b]);
+            totalContacts += contactCount[b];
+        }
+
+        // empty contacts for bodies with fewer, then the warm start impulses
+        for (int slot = 0; slot < numSlots; slot++) {
+            for (int b = 0; b < numBodies; b++) {
+                size_t k = (size_t)slot * numBodies + b;
+                if (slot >= contactCount[b]) {
+                    clearSlot(k);
+                    continue;
+                }
+                glm::vec3 v = velocities.linear(b), w = velocities.angular(b);
+                for (int d = 0; d < 3; d++) {
+                    const row& r = rows[d];
+                    v += glm::vec3(r.dirX[k], r.dirY[k], r.dirZ[k]) * (invMass[b] * r.lambda[k]);
+                    w += glm::vec3(r.angX[k], r.angY[k], r.angZ[k]) * r.lambda[k];
+                }
+                velocities.setLinear(b, v);
+                velocities.setAngular(b, w);
+            }
+        }
+
+        for (int it = 0; it < iterations; it++) {
+            for (int slot = 0; slot < numSlots; slot++) {
+                solveSlotBatch(velocities, invMass, slot);
+            }
+        }
+
+        // keep the impulses for next step, and forget the candidates that stopped touching
+        for (size_t c = 0; c < warmStarted.size(); c++) warmStarted[c] = 0;
+        for (int slot = 0; slot < numSlots; slot++) {
+            for (int b = 0; b < numBodies; b++) {
+                if (slot >= contactCount[b]) continue;
+                size_t k = (size_t)slot * numBodies + b;
+                size_t c = (size_t)b * candidatesPerBody + slotCandidate[k];
+                warmStarted[c] = 1;
+                for (int d = 0; d < 3; d++) warmLambda[d][c] = rows[d].lambda[k];
+            }
+        }
+    }
+
+    // the normal impulse on candidate of body over the last step, 0 if it wasn't touching
+    float normalImpulse(int body, int candidate) const {
+        size_t c = (size_t)body * candidatesPerBody + candidate;
+        return warmStarted[c] ? warmLambda[0][c] : 0.0f;
+    }
+
+private:
+    // one constraint direction (the normal, or one of the friction directions) of every slot
+    struct row {
+        std::vector<float> dirX, dirY, dirZ; // the impulse direction
+        std::vector<float> armX, armY, armZ; // arm x direction, what angular velocity adds along it
+        std::vector<float> angX, angY, angZ; // change in angular velocity per unit impulse
+        std::vector<float> mass; // effective mass along the direction
+        std::vector<float> bias; // added to the measured velocity
+        std::vector<float> lambda; // impulse accumulated this step
+    };
+
+    int numBodies;
+    int candidatesPerBody;
+    row rows[3]; // normal, then the two friction directions
+    std::vector<int> slotCandidate;
+    std::vector<int> contactCount;
+    std::vector<float> warmLambda[3]; // [body * candidatesPerBody + candidate]
+    std::vector<char> warmStarted;
+
+    void clearSlot(size_t k) {
+        for (int d = 0; d < 3; d++) {
+            row& r = rows[d];
+            r.dirX[k] = r.dirY[k] = r.dirZ[k] = 0.0f;
+            r.armX[k] = r.armY[k] = r.armZ[k] = 0.0f;
+            r.angX[k] = r.angY[k] = r.angZ[k] = 0.0f;
+            r.mass[k] = r.bias[k] = r.lambda[k] = 0.0f;
+        }
+    }
+
+    // one direction of a group of contacts: the impulse that zeroes its velocity, accumulated and clamped
+    // to [lo, hi], then applied to the bodies. returns the accumulated impulse
+    template <class V>
+    static typename V::F solveRow(row& r, size_t k, typename V::F invMass, typename V::F v[3], typename V::F w[3],
+                                  typename V::F lo, typename V::F hi) {
+        typedef typename V::F F;
+        F dir[3] = {V::load(&r.dirX[k]), V::load(&r.dirY[k]), V::load(&r.dirZ[k])};
+        F vel = V::madd(v[2], dir[2], V::madd(v[1], dir[1], V::mul(v[0], dir[0])));
+        vel = V::madd(w[0], V::load(&r.armX[k]), vel);
+        vel = V::madd(w[1], V::load(&r.armY[k]), vel);
+        vel = V::madd(w[2], V::load(&r.armZ[k]), vel);
+        vel = V::add(vel, V::load(&r.bias[k]));
+
+        F old = V::load(&r.lambda[k]);
+        F lambda = V::min(hi, V::max(lo, V::sub(old, V::mul(V::load(&r.mass[k]), vel))));
+        F delta = V::sub(lambda, old);
+        V::store(&r.lambda[k], lambda);
+
+        F linear = V::mul(delta, invMass);
+        for (int c = 0; c < 3; c++) v[c] = V::madd(dir[c], linear, v[c]);
+        w[0] = V::madd(V::load(&r.angX[k]), delta, w[0]);
+        w[1] = V::madd(V::load(&r.angY[k]), delta, w[1]);
+        w[2] = V::madd(V::load(&r.angZ[k]), delta, w[2]);
+        return lambda;
+    }
+
+    // slot slot of bodies [b, b + V::width)
+    template <class V>
+    void solveSlotLanes(BodyVelocities& bodies, const float* invMass, int slot, size_t b) {
+        typedef typename V::F F;
+        size_t k = (size_t)slot * numBodies + b;
+        F v[3] = {V::load(&bodies.vx[b]), V::load(&bodies.vy[b]), V::load(&bodies.vz[b])};
+        F w[3] = {V::load(&bodies.wx[b]), V::load(&bodies.wy[b]), V::load(&bodies.wz[b])};
+        F m = V::load(invMass + b);
+
+        // the normal can only push, and friction can't push harder than friction * the normal impulse
+        F normalImpulse = solveRow<V>(rows[0], k, m, v, w, V::set1(0.0f), V::set1(1e30f));
+        F limit = V::mul(V::set1(friction), normalImpulse);
+        F negLimit = V::sub(V::set1(0.0f), limit);
+        solveRow<V>(rows[1], k, m, v, w, negLimit, limit);
+        solveRow<V>(rows[2], k, m, v, w, negLimit, limit);
+
+        V::store(&bodies.vx[b], v[0]); V::store(&bodies.vy[b], v[1]); V::store(&bodies.vz[b], v[2]);
+        V::store(&bodies.wx[b], w[0]); V::store(&bodies.wy[b], w[1]); V::store(&bodies.wz[b], w[2]);
+    }
+
+    void solveSlotBatch(BodyVelocities& bodies, const float* invMass, int slot) {
+        size_t count = numBodies;
+        size_t b = 0;
+#ifdef GLPLAY_SIMD_AVX
+        for (; b + 8 <= count; b += 8) solveSlotLanes<simd::AvxLanes>(bodies, invMass, slot, b);
+#endif
+#ifdef GLPLAY_SIMD_SSE
+        for (; b + 4 <= count; b += 4) solveSlotLanes<simd::SseLanes>(bodies, invMass, slot, b);
+#endif
+        for (; b < count; b++) solveSlotLanes<simd::ScalarLanes>(bodies, invMass, slot, b);
+    }
+};
+
+#endif /* Contact.hpp */
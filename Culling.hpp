@@ -0,0 +1,238 @@
+#ifndef _CULLING_HPP
+#define _CULLING_HPP
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Renderer.hpp"
+#include "SimdMath.hpp"
+
+// view frustum culling for shape instances
+
+// the six planes of a view frustum with normals pointing inwards, so a point p is inside a plane when
+// dot(n, p) + d >= 0. kept structure-of-arrays and padded to 8 with planes everything is inside of, so
+// one box is tested against every plane at once: one avx2 pass or two sse passes
+struct frustumPlanes {
+    float nx[8];
+    float ny[8];
+    float nz[8];
+    float d[8];
+};
+
+// the planes of projection * view, straight from the rows of the matrix (gribb and hartmann)
+inline frustumPlanes extractFrustum(const glm::mat4& viewProjection) {
+    const glm::mat4& m = viewProjection;
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++) {
+        row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    }
+    glm::vec4 planes[6] = {
+        row[3] + row[0], row[3] - row[0], // left, right
+        row[3] + row[1], row[3] - row[1], // bottom, top
+        row[3] + row[2], row[3] - row[2] // near, far
+    };
+
+    frustumPlanes f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 p = (i < 6) ? planes[i] / glm::length(glm::vec3(planes[i])) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        f.nx[i] = p.x;
+        f.ny[i] = p.y;
+        f.nz[i] = p.z;
+        f.d[i] = p.w;
+    }
+    return f;
+}
+
+enum Cull_Result {
+    CULL_OUTSIDE, // entirely outside some plane
+    CULL_INTERSECTS, // might be partly visible
+    CULL_INSIDE // entirely inside every plane
+};
+
+// an axis aligned box against planes [first, first + V::width). outside gets set in lanes where the box is
+// entirely behind the plane, crossing where it isn't entirely in front
+template <class V>
+inline void boxPlanesLanes(const frustumPlanes& f, int first, const glm::vec3& center, const glm::vec3& extent,
+                           typename V::I& outside, typename V::I& crossing) {
+    typedef typename V::F F;
+    F nx = V::load(f.nx + first), ny = V::load(f.ny + first), nz = V::load(f.nz + first);
+    // signed distance from the plane to the center, and the box's reach towards the plane
+    F dist = V::madd(nx, V::set1(center.x), V::madd(ny, V::set1(center.y), V::madd(nz, V::set1(center.z), V::load(f.d + first))));
+    F reach = V::madd(V::abs(nx), V::set1(extent.x), V::madd(V::abs(ny), V::set1(extent.y), V::mul(V::abs(nz), V::set1(extent.z))));
+    outside = V::ori(outside, V::less(V::add(dist, reach), V::set1(0.0f)));
+    crossing = V::ori(crossing, V::less(V::sub(dist, reach), V::set1(0.0f)));
+}
+
+inline Cull_Result testBox(const frustumPlanes& f, const glm::vec3& center, const glm::vec3& extent) {
+    bool outside, crossing;
+#if defined(GLPLAY_SIMD_AVX)
+    simd::AvxLanes::I o = simd::AvxLanes::set1i(0), c = simd::AvxLanes::set1i(0);
+    boxPlanesLanes<simd::AvxLanes>(f, 0, center, extent, o, c);
+    outside = simd::AvxLanes::any(o);
+    crossing = simd::AvxLanes::any(c);
+#elif defined(GLPLAY_SIMD_SSE)
+    simd::SseLanes::I o = simd::SseLanes::set1i(0), c = simd::SseLanes::set1i(0);
+    boxPlanesLanes<simd::SseLanes>(f, 0, center, extent, o, c);
+    boxPlanesLanes<simd::SseLanes>(f, 4, center, extent, o, c);
+    outside = simd::SseLanes::any(o);
+    crossing = simd::SseLanes::any(c);
+#else
+    int o = 0, c = 0;
+    for (int i = 0; i < 8; i++) boxPlanesLanes<simd::ScalarLanes>(f, i, center, extent, o, c);
+    outside = o != 0;
+    crossing = c != 0;
+#endif
+    if (outside) return CULL_OUTSIDE;
+    return crossing ? CULL_INTERSECTS : CULL_INSIDE;
+}
+
+// world space bounds of an instance: its model matrix maps the unit cube, so the box's half extent along
+// each world axis is half the summed absolute columns
+inline void instanceBounds(const shapeInstance& instance, glm::vec3& center, glm::vec3& extent) {
+    const glm::mat4& m = instance.model;
+    center = glm::vec3(m[3]);
+    extent = 0.5f * (glm::abs(glm::vec3(m[0])) + glm::abs(glm::vec3(m[1])) + glm::abs(glm::vec3(m[2])));
+}
+
+// a bounding volume hierarchy over a frame's shape instances, for throwing away whole groups of them at once.
+//
+// the tree is built once from the first frame, splitting at the median along the longest axis, and after
+// that only refit: the boxes are recomputed from the new instances and merged back up the tree. robots
+// walk in place, so the grouping from the first frame stays good. it's rebuilt if the instance count changes
+class ShapeBVH {
+public:
+    static const int leafSize = 8;
+
+    // nodes visited and single boxes tested by the last cull, for checking how much work it saved
+    int nodesVisited = 0;
+    int boxesTested = 0;
+
+    // refits the tree to this frame's instances
+    void update(const shapeInstance* instances, int count) {
+        boxCenter.resize(count);
+        boxExtent.resize(count);
+        for (int i = 0; i < count; i++) {
+            instanceBounds(instances[i], boxCenter[i], boxExtent[i]);
+        }
+        if (count != (int)order.size()) {
+            build(count);
+        }
+
+        // children always come after their parent, so going backwards finishes both before the parent
+        for (int n = nodes.size() - 1; n >= 0; n--) {
+            node& nd = nodes[n];
+            if (nd.left < 0) {
+                nd.min = glm::vec3(INFINITY);
+                nd.max = glm::vec3(-INFINITY);
+                for (int k = nd.first; k < nd.first + nd.count; k++) {
+                    int i = order[k];
+                    nd.min = glm::min(nd.min, boxCenter[i] - boxExtent[i]);
+                    nd.max = glm::max(nd.max, boxCenter[i] + boxExtent[i]);
+                }
+            } else {
+                nd.min = glm::min(nodes[nd.left].min, nodes[nd.left + 1].min);
+                nd.max = glm::max(nodes[nd.left].max, nodes[nd.left + 1].max);
+            }
+        }
+    }
+
+    // copies every instance that might be visible to out, in tree order, and returns how many.
+    // instances has to be what update was last called with
+    int cull(const frustumPlanes& f, const shapeInstance* instances, shapeInstance* out) {
+        nodesVisited = 0;
+        boxesTested = 0;
+        if (nodes.empty()) {
+            return 0;
+        }
+
+        int written = 0;
+        int stack[64]; // median splits stay far shallower than this
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const node& nd = nodes[stack[--top]];
+            nodesVisited++;
+            Cull_Result result = testBox(f, 0.5f * (nd.min + nd.max), 0.5f * (nd.max - nd.min));
+            if (result == CULL_OUTSIDE) {
+                continue;
+            }
+            if (result == CULL_INSIDE) { // the whole subtree is visible, no more tests
+                for (int k = nd.first; k < nd.first + nd.count; k++) {
+                    out[written++] = instances[order[k]];
+                }
+                continue;
+            }
+            if (nd.left >= 0) {
+                stack[top++] = nd.left;
+                stack[top++] = nd.left + 1;
+                continue;
+            }
+            for (int k = nd.first; k < nd.first + nd.count; k++) {
+                int i = order[k];
+                boxesTested++;
+                if (testBox(f, boxCenter[i], boxExtent[i]) != CULL_OUTSIDE) {
+                    out[written++] = instances[i];
+                }
+            }
+        }
+        return written;
+    }
+
+private:
+    // a node covers order[first, first + count). leaves have left = -1, otherwise the children are
+    // nodes left and left + 1
+    struct node {
+        glm::vec3 min;
+        glm::vec3 max;
+        int first;
+        int count;
+        int left;
+    };
+
+    std::vector<node> nodes;
+    std::vector<int> order; // instance indices, so every node's instances are next to each other
+    std::vector<glm::vec3> boxCenter;
+    std::vector<glm::vec3> boxExtent;
+
+    void build(int count) {
+        order.resize(count);
+        for (int i = 0; i < count; i++) order[i] = i;
+        nodes.clear();
+        if (count == 0) {
+            return;
+        }
+        nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), 0, count, -1});
+        split(0);
+    }
+
+    void split(int n) {
+        int first = nodes[n].first, count = nodes[n].count;
+        if (count <= leafSize) {
+            return;
+        }
+
+        glm::vec3 lo(INFINITY), hi(-INFINITY);
+        for (int k = first; k < first + count; k++) {
+            lo = glm::min(lo, boxCenter[order[k]]);
+            hi = glm::max(hi, boxCenter[order[k]]);
+        }
+        glm::vec3 size = hi - lo;
+        int axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+
+        int half = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+                         [&](int a, int b) { return boxCenter[a][axis] < boxCenter[b][axis]; });
+
+        int left = nodes.size();
+        nodes[n].left = left;
+        nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), first, half, -1});
+        nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), first + half, count - half, -1});
+        split(left);
+        split(left + 1);
+    }
+};
+
+#endif /* Culling.hpp */
@@ -0,0 +1,412 @@
+#ifndef _DYNAMICS_HPP
+#define _DYNAMICS_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stddef.h>
+
+#include "Robot.cpp"
+#include "Kinematics.hpp"
+#include "SimdMath.hpp"
+
+// rigid body dynamics for a leg chain, in featherstone's spatial vector notation.
+//
+// a spatial motion vector is [angular; linear] and a spatial force is [moment; force], both expressed in
+// some segment's joint frame (the frames of Kinematics.hpp). every joint is revolute about its jointAxis,
+// so its motion subspace is S = [axis; 0]. the body the legs hang off is held still for now, which makes
+// each leg a separate fixed base chain, and gravity is handled the usual way, by giving the base an upward
+// acceleration of -gravity instead of adding a force to every segment.
+//
+// legInverseDynamics is the recursive newton euler reference (accelerations in, torques out), and
+// legForwardDynamicsBatch the articulated body algorithm (torques in, accelerations out), both O(segments)
+
+// segments are solid boxes of their dimensions, this dense
+const float segmentDensity = 1.0f;
+
+// mass properties of a segment, in its joint frame
+struct segmentInertia {
+    float mass;
+    glm::vec3 com; // center of mass
+    glm::mat3 rotational; // about the joint frame origin, not the center of mass
+};
+
+// a solid box of dimensions, centered baseOffset from the joint like the drawn shape
+inline segmentInertia partInertia(const Robot::legPart& part) {
+    glm::vec3 d = part.dimensions;
+    segmentInertia s;
+    s.mass = segmentDensity * d.x * d.y * d.z;
+    s.com = part.baseOffset;
+    glm::mat3 aboutCom(0.0f);
+    aboutCom[0][0] = s.mass / 12.0f * (d.y * d.y + d.z * d.z);
+    aboutCom[1][1] = s.mass / 12.0f * (d.x * d.x + d.z * d.z);
+    aboutCom[2][2] = s.mass / 12.0f * (d.x * d.x + d.y * d.y);
+    // parallel axis theorem
+    glm::vec3 c = s.com;
+    s.rotational = aboutCom + s.mass * (glm::dot(c, c) * glm::mat3(1.0f) - glm::outerProduct(c, c));
+    return s;
+}
+
+// the rotation from a segment's parent frame into its own, for a joint at angle about axis
+inline glm::mat3 jointRotationFromParent(const Robot::legPart& part, float angle) {
+    return glm::transpose(glm::mat3(glm::rotate(glm::mat4(1.0f), angle, part.jointAxis)));
+}
+
+// reference inverse dynamics using glm: the joint torques that give the leg joint accelerations qdd at
+// angles q and velocities qd, with gravity given in the robot frame. q, qd, qdd and tau hold one value
+// per segment of the leg
+inline void legInverseDynamics(const Robot& robot, int legIndex, const float* q, const float* qd, const float* qdd,
+                               glm::vec3 gravity, float* tau) {
+    const Robot::leg& l = robot.legs[legIndex];
+    const Robot::legPart* parts = &robot.segments[l.firstSegment];
+    int n = l.numSegments;
+    assert(n <= maxLegSegments);
+
+    glm::mat3 baseRotation(glm::rotate(glm::mat4(1.0f), l.baseRotationAngle, l.baseRotationAxis));
+    glm::vec3 vAng(0.0f), vLin(0.0f);
+    glm::vec3 aAng(0.0f), aLin = -(glm::transpose(baseRotation) * gravity);
+
+    glm::mat3 E[maxLegSegments];
+    glm::vec3 fAng[maxLegSegments], fLin[maxLegSegments];
+    for (int s = 0; s < n; s++) {
+        glm::vec3 axis = glm::normalize(parts[s].jointAxis);
+        glm::vec3 r = (s == 0) ? glm::vec3(0.0f) : parts[s - 1].connectOffset;
+        E[s] = jointRotationFromParent(parts[s], q[s]);
+
+        // move the parent's velocity and acceleration to this joint, then into its frame
+        vLin = E[s] * (vLin - glm::cross(r, vAng));
+        vAng = E[s] * vAng;
+        aLin = E[s] * (aLin - glm::cross(r, aAng));
+        aAng = E[s] * aAng;
+
+        glm::vec3 jointVelocity = axis * qd[s];
+        aAng += glm::cross(vAng, jointVelocity) + axis * qdd[s];
+        aLin += glm::cross(vLin, jointVelocity);
+        vAng += jointVelocity;
+
+        // f = I a + v x* I v
+        segmentInertia m = partInertia(parts[s]);
+        glm::vec3 hAng = m.rotational * vAng + m.mass * glm::cross(m.com, vLin);
+        glm::vec3 hLin = m.mass * (vLin - glm::cross(m.com, vAng));
+        fAng[s] = m.rotational * aAng + m.mass * glm::cross(m.com, aLin) + glm::cross(vAng, hAng) + glm::cross(vLin, hLin);
+        fLin[s] = m.mass * (aLin - glm::cross(m.com, aAng)) + glm::cross(vAng, hLin);
+    }
+
+    for (int s = n - 1; s >= 0; s--) {
+        tau[s] = glm::dot(glm::normalize(parts[s].jointAxis), fAng[s]);
+        if (s > 0) { // the parent carries this segment's force too
+            glm::vec3 r = parts[s - 1].connectOffset;
+            glm::vec3 f = glm::transpose(E[s]) * fLin[s];
+            fAng[s - 1] += glm::transpose(E[s]) * fAng[s] + glm::cross(r, f);
+            fLin[s - 1] += f;
+        }
+    }
+}
+
+// everything about a leg the articulated body algorithm needs that doesn't depend on its state.
+// the joint rotations come from the forward kinematics constants, so both agree on what an angle means
+struct LegDynamicsConstants {
+    LegChainConstants chain;
+    float axis[maxLegSegments][3];
+    bool hasOffset[maxLegSegments]; // whether the joint sits away from its parent's origin, false for the first
+    // spatial inertia of each segment as 3x3 blocks [A B; B^T C], column major: A is the rotational inertia
+    // about the joint, B = m [com]x and C = m I, so only the mass is kept for it
+    float inertiaA[maxLegSegments][9];
+    float inertiaB[maxLegSegments][9];
+    float mass[maxLegSegments];
+
+    LegDynamicsConstants() {}
+
+    LegDynamicsConstants(const Robot& robot, int legIndex) : chain(robot, legIndex) {
+        const Robot::legPart* parts = &robot.segments[robot.legs[legIndex].firstSegment];
+        for (int s = 0; s < chain.numSegments; s++) {
+            glm::vec3 n = glm::normalize(parts[s].jointAxis);
+            glm::vec3 r = (s == 0) ? glm::vec3(0.0f) : parts[s - 1].connectOffset;
+            segmentInertia m = partInertia(parts[s]);
+            glm::vec3 c = m.com;
+            float comCross[9] = {0.0f, c.z, -c.y, -c.z, 0.0f, c.x, c.y, -c.x, 0.0f};
+            for (int e = 0; e < 9; e++) {
+                inertiaA[s][e] = m.rotational[e / 3][e % 3];
+                inertiaB[s][e] = m.mass * comCross[e];
+            }
+            for (int k = 0; k < 3; k++) {
+                axis[s][k] = n[k];
+            }
+            hasOffset[s] = r != glm::vec3(0.0f);
+            mass[s] = m.mass;
+        }
+    }
+};
+
+// small 3d helpers on lanes, for the articulated body kernel. matrices are column major F[9]. outputs may
+// alias inputs
+namespace spatial {
+
+template <class V>
+inline void cross(const typename V::F a[3], const typename V::F b[3], typename V::F out[3]) {
+    typename V::F x = V::sub(V::mul(a[1], b[2]), V::mul(a[2], b[1]));
+    typename V::F y = V::sub(V::mul(a[2], b[0]), V::mul(a[0], b[2]));
+    typename V::F z = V::sub(V::mul(a[0], b[1]), V::mul(a[1], b[0]));
+    out[0] = x; out[1] = y; out[2] = z;
+}
+
+// cross product with a constant vector, r x b
+template <class V>
+inline void crossConst(const float r[3], const typename V::F b[3], typename V::F out[3]) {
+    typename V::F x = V::sub(V::mul(V::set1(r[1]), b[2]), V::mul(V::set1(r[2]), b[1]));
+    typename V::F y = V::sub(V::mul(V::set1(r[2]), b[0]), V::mul(V::set1(r[0]), b[2]));
+    typename V::F z = V::sub(V::mul(V::set1(r[0]), b[1]), V::mul(V::set1(r[1]), b[0]));
+    out[0] = x; out[1] = y; out[2] = z;
+}
+
+// m v
+template <class V>
+inline void mulVec(const typename V::F m[9], const typename V::F v[3], typename V::F out[3]) {
+    typename V::F o[3];
+    for (int r = 0; r < 3; r++) {
+        o[r] = V::madd(m[6 + r], v[2], V::madd(m[3 + r], v[1], V::mul(m[r], v[0])));
+    }
+    out[0] = o[0]; out[1] = o[1]; out[2] = o[2];
+}
+
+// m^T v
+template <class V>
+inline void mulTransposedVec(const typename V::F m[9], const typename V::F v[3], typename V::F out[3]) {
+    typename V::F o[3];
+    for (int c = 0; c < 3; c++) {
+        o[c] = V::madd(m[c * 3 + 2], v[2], V::madd(m[c * 3 + 1], v[1], V::mul(m[c * 3], v[0])));
+    }
+    out[0] = o[0]; out[1] = o[1]; out[2] = o[2];
+}
+
+// e^T m e, rotating a 3x3 block of an inertia from a segment's frame into its parent's
+template <class V>
+inline void rotateBlock(const typename V::F e[9], const typename V::F m[9], typename V::F out[9]) {
+    typename V::F me[9];
+    for (int c = 0; c < 3; c++) {
+        mulVec<V>(m, e + c * 3, me + c * 3);
+    }
+    for (int c = 0; c < 3; c++) {
+        mulTransposedVec<V>(e, me + c * 3, out + c * 3);
+    }
+}
+
+// m [r]x for a constant r: column c of [r]x is r x unit(c)
+template <class V>
+inline void mulCrossConst(const typename V::F m[9], const float r[3], typename V::F out[9]) {
+    typename V::F o[9];
+    for (int row = 0; row < 3; row++) {
+        o[row] = V::sub(V::mul(V::set1(r[2]), m[3 + row]), V::mul(V::set1(r[1]), m[6 + row]));
+        o[3 + row] = V::sub(V::mul(V::set1(r[0]), m[6 + row]), V::mul(V::set1(r[2]), m[row]));
+        o[6 + row] = V::sub(V::mul(V::set1(r[1]), m[row]), V::mul(V::set1(r[0]), m[3 + row]));
+    }
+    for (int e = 0; e < 9; e++) out[e] = o[e];
+}
+
+} // namespace spatial
+
+// the articulated body algorithm for one group of V::width chains of the same leg. q, qd, tau and qdd are
+// structure-of-arrays like the forward kinematics: segment s of chain i at [s * stride + i].
+// gravityBase is the gravity vector already in the leg's base frame
+template <class V>
+inline void legABALanes(const LegDynamicsConstants& k, const float gravityBase[3], const float* q, const float* qd,
+                        const float* tau, float* qdd, size_t i, size_t stride) {
+    typedef typename V::F F;
+    const int n = k.chain.numSegments;
+    const F zero = V::set1(0.0f);
+
+    F E[maxLegSegments][9]; // rotation from the parent's frame into the segment's
+    F vAng[maxLegSegments][3], vLin[maxLegSegments][3]; // segment velocity
+    F cAng[maxLegSegments][3], cLin[maxLegSegments][3]; // velocity product acceleration
+    F IA[maxLegSegments][27]; // articulated inertia, blocks A, B and C
+    F pAng[maxLegSegments][3], pLin[maxLegSegments][3]; // articulated bias force
+    F UAng[maxLegSegments][3], ULin[maxLegSegments][3]; // IA S
+    F Dinv[maxLegSegments], u[maxLegSegments];
+
+    // outwards: velocities, and each segment's own inertia and bias force
+    for (int s = 0; s < n; s++) {
+        const float* axis = k.axis[s];
+        F sinA, cosA;
+        simd::sincos<V>(V::load(q + s * stride + i), sinA, cosA);
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) {
+                // the joint's rotation transposed
+                int e = row * 3 + col;
+                E[s][col * 3 + row] = V::madd(V::set1(k.chain.axisSin[s][e]), sinA,
+                                              V::madd(V::set1(k.chain.axisCos[s][e]), cosA, V::set1(k.chain.axisOuter[s][e])));
+            }
+        }
+
+        F jointSpeed = V::load(qd + s * stride + i);
+        F w[3] = {zero, zero, zero}, vl[3] = {zero, zero, zero};
+        if (s > 0) {
+            for (int c = 0; c < 3; c++) {
+                w[c] = vAng[s - 1][c];
+                vl[c] = vLin[s - 1][c];
+            }
+            if (k.hasOffset[s]) {
+                F rw[3];
+                spatial::crossConst<V>(k.chain.connectOffset[s - 1], w, rw);
+                for (int c = 0; c < 3; c++) vl[c] = V::sub(vl[c], rw[c]);
+            }
+            spatial::mulVec<V>(E[s], w, w);
+            spatial::mulVec<V>(E[s], vl, vl);
+        }
+        F sqd[3];
+        for (int c = 0; c < 3; c++) {
+            sqd[c] = V::mul(V::set1(axis[c]), jointSpeed);
+            w[c] = V::add(w[c], sqd[c]);
+        }
+        // c = v x S qd
+        spatial::cross<V>(w, sqd, cAng[s]);
+        spatial::cross<V>(vl, sqd, cLin[s]);
+
+        for (int e = 0; e < 9; e++) {
+            IA[s][e] = V::set1(k.inertiaA[s][e]);
+            IA[s][9 + e] = V::set1(k.inertiaB[s][e]);
+            IA[s][18 + e] = V::set1((e % 4 == 0) ? k.mass[s] : 0.0f);
+        }
+
+        // p = v x* I v
+        F hAng[3], hLin[3], t[3];
+        spatial::mulVec<V>(IA[s], w, hAng);
+        spatial::mulVec<V>(IA[s] + 9, vl, t);
+        for (int c = 0; c < 3; c++) hAng[c] = V::add(hAng[c], t[c]);
+        spatial::mulTransposedVec<V>(IA[s] + 9, w, hLin);
+        for (int c = 0; c < 3; c++) hLin[c] = V::madd(V::set1(k.mass[s]), vl[c], hLin[c]);
+        spatial::cross<V>(w, hAng, pAng[s]);
+        spatial::cross<V>(vl, hLin, t);
+        for (int c = 0; c < 3; c++) pAng[s][c] = V::add(pAng[s][c], t[c]);
+        spatial::cross<V>(w, hLin, pLin[s]);
+
+        for (int c = 0; c < 3; c++) {
+            vAng[s][c] = w[c];
+            vLin[s][c] = vl[c];
+        }
+    }
+
+    // inwards: fold each segment's articulated inertia into its parent's
+    for (int s = n - 1; s >= 0; s--) {
+        const float* axis = k.axis[s];
+        F S[3] = {V::set1(axis[0]), V::set1(axis[1]), V::set1(axis[2])};
+        spatial::mulVec<V>(IA[s], S, UAng[s]); // A s
+        spatial::mulTransposedVec<V>(IA[s] + 9, S, ULin[s]); // B^T s
+        F D = V::madd(S[2], UAng[s][2], V::madd(S[1], UAng[s][1], V::mul(S[0], UAng[s][0])));
+        Dinv[s] = V::div(V::set1(1.0f), D);
+        F sp = V::madd(S[2], pAng[s][2], V::madd(S[1], pAng[s][1], V::mul(S[0], pAng[s][0])));
+        u[s] = V::sub(V::load(tau + s * stride + i), sp);
+        if (s == 0) {
+            continue; // the base is fixed, so nothing to pass on
+        }
+
+        // Ia = IA - U U^T / D
+        F U[6] = {UAng[s][0], UAng[s][1], UAng[s][2], ULin[s][0], ULin[s][1], ULin[s][2]};
+        F Ia[27];
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) {
+                int e = col * 3 + row;
+                Ia[e] = V::sub(IA[s][e], V::mul(V::mul(U[row], U[col]), Dinv[s]));
+                Ia[9 + e] = V::sub(IA[s][9 + e], V::mul(V::mul(U[row], U[3 + col]), Dinv[s]));
+                Ia[18 + e] = V::sub(IA[s][18 + e], V::mul(V::mul(U[3 + row], U[3 + col]), Dinv[s]));
+            }
+        }
+
+        // pa = pA + Ia c + U u / D
+        F uD = V::mul(u[s], Dinv[s]);
+        F paAng[3], paLin[3], t[3];
+        spatial::mulVec<V>(Ia, cAng[s], paAng);
+        spatial::mulVec<V>(Ia + 9, cLin[s], t);
+        for (int c = 0; c < 3; c++) paAng[c] = V::add(V::add(pAng[s][c], paAng[c]), V::madd(U[c], uD, t[c]));
+        spatial::mulTransposedVec<V>(Ia + 9, cAng[s], paLin);
+        spatial::mulVec<V>(Ia + 18, cLin[s], t);
+        for (int c = 0; c < 3; c++) paLin[c] = V::add(V::add(pLin[s][c], paLin[c]), V::madd(U[3 + c], uD, t[c]));
+
+        // into the parent's frame: rotate by E^T, then shift from the joint back to the parent's origin
+        F A[9], B[9], C[9];
+        spatial::rotateBlock<V>(E[s], Ia, A);
+        spatial::rotateBlock<V>(E[s], Ia + 9, B);
+        spatial::rotateBlock<V>(E[s], Ia + 18, C);
+        spatial::mulTransposedVec<V>(E[s], paAng, paAng);
+        spatial::mulTransposedVec<V>(E[s], paLin, paLin);
+        if (k.hasOffset[s]) {
+            // X^T I X for a shift by r is [A - B rx + rx B^T - rx C rx, B + rx C; ., C],
+            // and B rx = P gives rx B^T = -P^T
+            const float* r = k.chain.connectOffset[s - 1];
+            F P[9], Q[9];
+            spatial::mulCrossConst<V>(B, r, P);
+            spatial::mulCrossConst<V>(C, r, Q);
+            for (int c = 0; c < 3; c++) {
+                spatial::crossConst<V>(r, Q + c * 3, Q + c * 3); // rx C rx
+            }
+            F rC[9];
+            for (int c = 0; c < 3; c++) {
+                spatial::crossConst<V>(r, C + c * 3, rC + c * 3);
+            }
+            for (int col = 0; col < 3; col++) {
+                for (int row = 0; row < 3; row++) {
+                    int e = col * 3 + row;
+                    A[e] = V::sub(V::sub(A[e], V::add(P[e], P[row * 3 + col])), Q[e]);
+                }
+            }
+            for (int e = 0; e < 9; e++) B[e] = V::add(B[e], rC[e]);
+            F rf[3];
+            spatial::crossConst<V>(r, paLin, rf);
+            for (int c = 0; c < 3; c++) paAng[c] = V::add(paAng[c], rf[c]);
+        }
+        for (int e = 0; e < 9; e++) {
+            IA[s - 1][e] = V::add(IA[s - 1][e], A[e]);
+            IA[s - 1][9 + e] = V::add(IA[s - 1][9 + e], B[e]);
+            IA[s - 1][18 + e] = V::add(IA[s - 1][18 + e], C[e]);
+        }
+        for (int c = 0; c < 3; c++) {
+            pAng[s - 1][c] = V::add(pAng[s - 1][c], paAng[c]);
+            pLin[s - 1][c] = V::add(pLin[s - 1][c], paLin[c]);
+        }
+    }
+
+    // outwards again: accelerations
+    F aAng[3] = {zero, zero, zero};
+    F aLin[3] = {V::set1(-gravityBase[0]), V::set1(-gravityBase[1]), V::set1(-gravityBase[2])};
+    for (int s = 0; s < n; s++) {
+        if (k.hasOffset[s]) {
+            F ra[3];
+            spatial::crossConst<V>(k.chain.connectOffset[s - 1], aAng, ra);
+            for (int c = 0; c < 3; c++) aLin[c] = V::sub(aLin[c], ra[c]);
+        }
+        spatial::mulVec<V>(E[s], aAng, aAng);
+        spatial::mulVec<V>(E[s], aLin, aLin);
+        for (int c = 0; c < 3; c++) {
+            aAng[c] = V::add(aAng[c], cAng[s][c]);
+            aLin[c] = V::add(aLin[c], cLin[s][c]);
+        }
+        F Ua = V::mul(UAng[s][0], aAng[0]);
+        for (int c = 1; c < 3; c++) Ua = V::madd(UAng[s][c], aAng[c], Ua);
+        for (int c = 0; c < 3; c++) Ua = V::madd(ULin[s][c], aLin[c], Ua);
+        F acc = V::mul(V::sub(u[s], Ua), Dinv[s]);
+        V::store(qdd + s * stride + i, acc);
+        for (int c = 0; c < 3; c++) {
+            aAng[c] = V::madd(V::set1(k.axis[s][c]), acc, aAng[c]);
+        }
+    }
+}
+
+// joint accelerations for count chains of the same leg under joint torques tau, 8 (avx2) or 4 (sse) at a
+// time. gravity is in the robot frame, the layout is the same as legChainFKBatch's angles
+inline void legForwardDynamicsBatch(const LegDynamicsConstants& k, glm::vec3 gravity, const float* q, const float* qd,
+                                    const float* tau, float* qdd, size_t count, size_t stride) {
+    // into the leg's base frame, once for the whole batch
+    float g[3];
+    for (int c = 0; c < 3; c++) {
+        g[c] = k.chain.base[c * 3] * gravity.x + k.chain.base[c * 3 + 1] * gravity.y + k.chain.base[c * 3 + 2] * gravity.z;
+    }
+    size_t i = 0;
+#ifdef GLPLAY_SIMD_AVX
+    for (; i + 8 <= count; i += 8) legABALanes<simd::AvxLanes>(k, g, q, qd, tau, qdd, i, stride);
+#endif
+#ifdef GLPLAY_SIMD_SSE
+    for (; i + 4 <= count; i += 4) legABALanes<simd::SseLanes>(k, g, q, qd, tau, qdd, i, stride);
+#endif
+    for (; i < count; i++) legABALanes<simd::ScalarLanes>(k, g, q, qd, tau, qdd, i, stride);
+}
+
+#endif /* Dynamics.hpp */
@@ -0,0 +1,43 @@
+#ifndef _FIXEDSTEP_HPP
+#define _FIXEDSTEP_HPP
+
+// turns real time into a whole number of fixed size simulation steps. elapsed time goes into an accumulator,
+// and every full dt in it is a step to run, so the simulation only ever sees the same dt whatever the frame
+// rate and gives the same results however the time was sliced. what's left over (less than one dt) carries
+// into the next advance, and is how far past the last step real time already is, for interpolating.
+// a hitch would ask for a burst of steps that take longer than the time they cover and fall further behind
+// every time, so at most maxSteps are run per advance and any time past that is dropped: the simulation
+// slows down instead of spiralling
+class FixedStep {
+public:
+    double dt;
+    int maxSteps;
+
+    // steps skipped by the catch up guard since this was made
+    long droppedSteps = 0;
+
+    FixedStep(double dt, int maxSteps = 8) : dt(dt), maxSteps(maxSteps) {}
+
+    // adds elapsed seconds of real time and returns how many steps to run for them, in [0, maxSteps]
+    int advance(double elapsed) {
+        accumulator += elapsed;
+        long steps = (long)(accumulator / dt);
+        if (steps > maxSteps) {
+            droppedSteps += steps - maxSteps;
+            accumulator -= (steps - maxSteps) * dt;
+            steps = maxSteps;
+        }
+        accumulator -= steps * dt;
+        return steps;
+    }
+
+    // real time passed since the last step that hasn't been simulated, in [0, dt)
+    double leftover() const {
+        return accumulator;
+    }
+
+private:
+    double accumulator = 0.0;
+};
+
+#endif /* FixedStep.hpp */
@@ -0,0 +1,49 @@
+#ifndef _GLSTATE_HPP
+#define _GLSTATE_HPP
+
+#include <glad/glad.h>
+
+// remembers the bound program and vertex array so binding the one that's already bound never reaches the
+// driver. gl state belongs to the context, so this does too: everything here assumes one context on one
+// thread, which is all app.cpp and the tools ever make. anything that binds these has to go through here,
+// or call reset() after it did so the cache stops trusting what it remembers
+class GLState {
+public:
+    // how many binds went to gl, and how many were dropped because they changed nothing
+    static inline long issued = 0;
+    static inline long skipped = 0;
+
+    static void useProgram(unsigned int program) {
+        if (program == currentProgram) {
+            skipped++;
+            return;
+        }
+        currentProgram = program;
+        issued++;
+        glUseProgram(program);
+    }
+
+    static void bindVertexArray(unsigned int VAO) {
+        if (VAO == currentVAO) {
+            skipped++;
+            return;
+        }
+        currentVAO = VAO;
+        issued++;
+        glBindVertexArray(VAO);
+    }
+
+    // forget what's bound, so the next bind of each goes through. for a new context, or after deleting
+    // whatever was bound, since gl can hand its name out again
+    static void reset() {
+        currentProgram = unknown;
+        currentVAO = unknown;
+    }
+
+private:
+    static const unsigned int unknown = 0xFFFFFFFF; // never a real name
+    static inline unsigned int currentProgram = unknown;
+    static inline unsigned int currentVAO = unknown;
+};
+
+#endif /* GLState.hpp */
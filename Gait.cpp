@@ -0,0 +1,165 @@
+#ifndef _GAIT_CPP
+#define _GAIT_CPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+#include "Robot.cpp"
+#include "Kinematics.hpp"
+
+enum Gait_Type {
+    GAIT_TRIPOD, // two groups of three legs alternate, fastest
+    GAIT_WAVE, // one leg in the air at a time, slowest and most stable
+    GAIT_RIPPLE // overlapping waves on each side, in between
+};
+
+// joint angle trajectories for walking, precomputed for one normalized gait cycle.
+//
+// each foot sweeps backwards along the walking direction while on the ground (stance) and lifts and swings
+// forward while in the air (swing). the foot path is turned into joint angles with IK once, here, and stored
+// as a table per leg with the leg's phase offset already baked in, so stepping a robot is just advancing a
+// phase and interpolating between two table entries
+class GaitTable {
+public:
+    static const int samplesPerCycle = 64;
+    // the tables come from solveLegIK, so they're only for robots whose legs are its 3 part layout
+    static const int jointsPerLeg = 3;
+
+    Gait_Type type;
+    int numLegs;
+    float dutyFactor; // fraction of the cycle each foot spends on the ground
+
+    // in the robot frame
+    glm::vec3 walkDirection = glm::vec3(1.0f, 0.0f, 0.0f);
+    float strideLength = 0.5f; // the knee's small range leaves about this much radial travel
+    float stepHeight = 0.6f;
+
+    // neutral foot position in each leg's own frame: out from the hip, below it
+    float neutralReach = 5.9f;
+    float neutralHeight = -3.0f;
+
+    GaitTable(const Robot& robot, Gait_Type gaitType) {
+        type = gaitType;
+        numLegs = robot.legs.size();
+        for (const Robot::leg& l : robot.legs) {
+            assert(l.numSegments == jointsPerLeg);
+        }
+
+        // phase at which each leg starts its swing, for legs numbered around the body.
+        // robots with fewer than 6 legs use the first ones
+        static const float tripodOffsets[6] = {0.0f, 0.5f, 0.0f, 0.5f, 0.0f, 0.5f};
+        static const float waveOffsets[6] = {0.0f, 1.0f / 6, 2.0f / 6, 3.0f / 6, 4.0f / 6, 5.0f / 6};
+        static const float rippleOffsets[6] = {0.0f, 2.0f / 3, 1.0f / 3, 5.0f / 6, 1.0f / 6, 1.0f / 2};
+
+        const float* offsets;
+        switch (type) {
+        case GAIT_WAVE:
+            dutyFactor = 5.0f / 6.0f;
+            offsets = waveOffsets;
+            break;
+        case GAIT_RIPPLE:
+            dutyFactor = 2.0f / 3.0f;
+            offsets = rippleOffsets;
+            break;
+        case GAIT_TRIPOD:
+        default:
+            dutyFactor = 0.5f;
+            offsets = tripodOffsets;
+            break;
+        }
+
+        table.resize((size_t)numLegs * samplesPerCycle * jointsPerLeg);
+        for (int i = 0; i < numLegs; i++) {
+            buildLeg(robot, i, offsets[i % 6]);
+        }
+    }
+
+    // joint angles of one leg at a point in the cycle (phase in [0, 1)), interpolated from the table
+    void sample(float phase, int legIndex, float angles[jointsPerLeg]) const {
+        float f = phase * samplesPerCycle;
+        int k = (int)f;
+        float t = f - k;
+        k = k % samplesPerCycle;
+        int next = (k + 1) % samplesPerCycle;
+
+        const float* a = &table[((size_t)legIndex * samplesPerCycle + k) * jointsPerLeg];
+        const float* b = &table[((size_t)legIndex * samplesPerCycle + next) * jointsPerLeg];
+        // the yaw joint turns all the way round, so a leg whose table crosses +-pi goes the short way
+        // across it instead of sweeping back through zero
+        angles[0] = wrapAngle(a[0] + wrapAngle(b[0] - a[0]) * t);
+        for (int j = 1; j < jointsPerLeg; j++) {
+            angles[j] = a[j] + (b[j] - a[j]) * t;
+        }
+    }
+
+private:
+    // [(leg * samplesPerCycle + sample) * jointsPerLeg + joint]
+    std::vector<float> table;
+
+    // foot position relative to the leg's neutral point at a given point in the leg's own cycle:
+    // x along the walking direction, y up
+    glm::vec2 footPath(float legPhase) const {
+        float swingFraction = 1.0f - dutyFactor;
+        if (legPhase < swingFraction) { // swing: back to front, lifted
+            float s = legPhase / swingFraction;
+            return glm::vec2((s - 0.5f) * strideLength, stepHeight * glm::sin(s * glm::pi<float>()));
+        }
+        float s = (legPhase - swingFraction) / dutyFactor; // stance: front to back, on the ground
+        return glm::vec2((0.5f - s) * strideLength, 0.0f);
+    }
+
+    // only for the 3 part legs solveLegIK handles
+    void buildLeg(const Robot& robot, int legIndex, float phaseOffset) {
+        const Robot::leg& l = robot.legs[legIndex];
+        const Robot::legPart* parts = &robot.segments[l.firstSegment];
+        glm::mat4 legBase = glm::translate(glm::mat4(1.0f), l.baseOffset);
+        legBase = glm::rotate(legBase, l.baseRotationAngle, l.baseRotationAxis);
+        glm::vec3 neutral = glm::vec3(legBase * glm::vec4(neutralReach, neutralHeight, 0.0f, 1.0f));
+
+        float hipLength = glm::length(parts[0].connectOffset);
+        float upperLength = glm::length(parts[1].connectOffset);
+        float lowerLength = glm::length(parts[2].connectOffset);
+        float kneeCos = glm::cos(glm::max(glm::abs(parts[2].minJointAngle), glm::abs(parts[2].maxJointAngle)));
+        float minReachSq = upperLength * upperLength + lowerLength * lowerLength + 2.0f * upperLength * lowerLength * kneeCos;
+        float maxReachSq = (upperLength + lowerLength) * (upperLength + lowerLength);
+
+        float previous[jointsPerLeg] = {0.0f, 0.0f, 0.0f};
+        for (int k = 0; k < samplesPerCycle; k++) {
+            float legPhase = glm::fract((float)k / samplesPerCycle - phaseOffset);
+            glm::vec2 offset = footPath(legPhase);
+            glm::vec3 target = neutral + walkDirection * offset.x + glm::vec3(0.0f, offset.y, 0.0f);
+
+            // the knee's range is small, so the two pitch links only reach a thin shell. pull targets
+            // radially into that shell instead of letting IK clamp the joints, so the foot still follows
+            // the path as closely as the leg allows
+            glm::vec3 p = glm::vec3(glm::inverse(legBase) * glm::vec4(target, 1.0f));
+            float horizontal = glm::sqrt(p.x * p.x + p.z * p.z);
+            float heightSq = p.y * p.y;
+            float u = horizontal - hipLength;
+            float uMin = glm::sqrt(glm::max(0.0f, minReachSq - heightSq));
+            float uMax = glm::sqrt(glm::max(0.0f, maxReachSq - heightSq));
+            float clampedU = glm::clamp(u, uMin * 1.001f, uMax * 0.999f);
+            if (horizontal > 0.0f && clampedU != u) {
+                float scale = (clampedU + hipLength) / horizontal;
+                p.x *= scale;
+                p.z *= scale;
+                target = glm::vec3(legBase * glm::vec4(p, 1.0f));
+            }
+
+            float angles[jointsPerLeg];
+            if (solveLegIK(robot, legIndex, target, angles) == IK_OUT_OF_REACH) {
+                for (int j = 0; j < jointsPerLeg; j++) angles[j] = previous[j]; // hold the last pose
+            }
+
+            float* out = &table[((size_t)legIndex * samplesPerCycle + k) * jointsPerLeg];
+            for (int j = 0; j < jointsPerLeg; j++) {
+                out[j] = angles[j];
+                previous[j] = angles[j];
+            }
+        }
+    }
+};
+
+#endif /* Gait.cpp */
@@ -0,0 +1,83 @@
+#ifndef _GEOMETRYREGISTRY_HPP
+#define _GEOMETRYREGISTRY_HPP
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "Renderer.hpp"
+#include "GLState.hpp"
+
+// where a mesh lives inside the registry's shared buffers
+struct meshRange {
+    int baseVertex; // added to every index of the mesh
+    int firstIndex;
+    int indexCount;
+};
+
+// every static mesh packed into one vertex buffer and one index buffer behind a single vao, so switching
+// between meshes is just a different range in the draw call and never a vao rebind.
+// add the meshes, upload() once, then draw them with glDrawElements*BaseVertex using range(id)
+class GeometryRegistry {
+public:
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int IBO = 0;
+
+    // returns the id to look the mesh's range up with. only before upload()
+    int addMesh(const meshData& mesh) {
+        meshRange r = {(int)(vertices.size() / 6), (int)indices.size(), (int)mesh.indices.size()};
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end()); // still relative to the mesh
+        ranges.push_back(r);
+        return ranges.size() - 1;
+    }
+
+    // creates the buffers and the vao with the per vertex attributes: position at 0, normal at 1.
+    // the index buffer is part of the vao's state, so binding the vao is all a draw needs
+    void upload() {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &IBO);
+
+        GLState::bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0); // position attribute
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float))); // normal attribute
+        glEnableVertexAttribArray(1);
+        GLState::bindVertexArray(0);
+
+        // the gpu has them now
+        vertices = std::vector<float>();
+        indices = std::vector<unsigned int>();
+    }
+
+    const meshRange& range(int id) const {
+        return ranges[id];
+    }
+
+    int meshCount() const {
+        return ranges.size();
+    }
+
+    // call while the context still exists
+    void release() {
+        GLState::bindVertexArray(0); // the name can come back from gl for a different vao
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &IBO);
+        VAO = VBO = IBO = 0;
+    }
+
+private:
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<meshRange> ranges;
+};
+
+#endif /* GeometryRegistry.hpp */
@@ -0,0 +1,121 @@
+#ifndef _INSTANCERENDERER_HPP
+#define _INSTANCERENDERER_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#include "Renderer.hpp"
+#include "GeometryRegistry.hpp"
+#include "StreamBuffer.hpp"
+
+// draws shapes as instances of the registry's meshes, one draw call per mesh.
+// each shape's model matrix (transformation scaled by its dimensions), color and normal matrix go into an
+// instance buffer that's attached to the registry's vertex array, and shader.vs reads them as per instance
+// attributes at locations 2-5 (model, one column each), 6 (color) and 7-9 (normal matrix, one column each).
+//
+// the instance buffer is a StreamBuffer, so instances can be written straight into gpu visible memory:
+// beginInstances() hands out space for up to maxInstances, endInstances() says how many were written,
+// then draw() any ranges of them with whichever meshes and endFrame() when the frame's draws are submitted
+class InstanceRenderer {
+public:
+    // the registry has to be uploaded already
+    InstanceRenderer(const GeometryRegistry& geometry, int maxInstances)
+        : VAO(geometry.VAO), geometry(geometry), maxInstances(maxInstances),
+          instanceBuffer(GL_ARRAY_BUFFER, (size_t)maxInstances * sizeof(shapeInstance)) {
+        GLState::bindVertexArray(VAO);
+        for (int location = 2; location < 10; location++) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1); // advance once per instance instead of once per vertex
+        }
+        pointAttributesAt(0);
+        GLState::bindVertexArray(0);
+    }
+
+    InstanceRenderer(const InstanceRenderer&) = delete;
+    InstanceRenderer& operator=(const InstanceRenderer&) = delete;
+
+    int capacity() const {
+        return maxInstances;
+    }
+
+    // space for this frame's instances, at most capacity(). may wait for the gpu to finish with it first
+    shapeInstance* beginInstances() {
+        return (shapeInstance*)instanceBuffer.begin();
+    }
+
+    void endInstances(int count) {
+        instanceBuffer.end();
+        numInstances = glm::min(count, maxInstances);
+    }
+
+    // builds this frame's instances from shapes
+    void upload(const shape* shapes, int count) {
+        shapeInstance* out = beginInstances();
+        count = glm::min(count, maxInstances);
+        for (int i = 0; i < count; i++) {
+            writeShapeInstance(out[i], shapes[i].transformation, shapes[i].dimensions, shapes[i].color);
+        }
+        endInstances(count);
+    }
+
+    // draws instances [firstInstance, firstInstance + count) of this frame's as the given mesh, all of them
+    // by default. the shader has to be in use already
+    void draw(int meshId, int firstInstance = 0, int count = -1) {
+        if (count < 0 || firstInstance + count > numInstances) {
+            count = numInstances - firstInstance;
+        }
+        if (count <= 0) {
+            return;
+        }
+        GLState::bindVertexArray(VAO); // the same vao whatever the mesh, so only the first draw binds it
+        // this frame's region of the ring, then the first instance within it. gl 3.3 has no base instance
+        pointAttributesAt(instanceBuffer.offset() + firstInstance * sizeof(shapeInstance));
+        const meshRange& mesh = geometry.range(meshId);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT,
+                                          (void*)(mesh.firstIndex * sizeof(unsigned int)), count, mesh.baseVertex);
+    }
+
+    // call once this frame's draws are submitted, so the instance space can be reused once they're done
+    void endFrame() {
+        instanceBuffer.fence();
+        numInstances = 0;
+    }
+
+    // how many times the cpu had to wait for the gpu to free up instance space
+    long stalls() const {
+        return instanceBuffer.stalls;
+    }
+
+    bool isPersistent() const {
+        return instanceBuffer.isPersistent();
+    }
+
+    // frees the instance buffer. call while the context still exists, like the other gl cleanup
+    void release() {
+        instanceBuffer.release();
+        numInstances = 0;
+    }
+
+private:
+    unsigned int VAO;
+    const GeometryRegistry& geometry;
+    int maxInstances;
+    StreamBuffer instanceBuffer;
+    int numInstances = 0;
+
+    // the vao has to be bound
+    void pointAttributesAt(size_t base) {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.ID);
+        for (int col = 0; col < 4; col++) { // a mat4 attribute takes four vec4 slots
+            glVertexAttribPointer(2 + col, 4, GL_FLOAT, GL_FALSE, sizeof(shapeInstance), (void*)(base + offsetof(shapeInstance, model) + col * sizeof(glm::vec4)));
+        }
+        glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(shapeInstance), (void*)(base + offsetof(shapeInstance, color)));
+        for (int col = 0; col < 3; col++) {
+            glVertexAttribPointer(7 + col, 3, GL_FLOAT, GL_FALSE, sizeof(shapeInstance), (void*)(base + offsetof(shapeInstance, normalMatrix) + col * sizeof(glm::vec3)));
+        }
+    }
+};
+
+#endif /* InstanceRenderer.hpp */
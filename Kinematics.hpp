@@ -0,0 +1,429 @@
+#ifndef _KINEMATICS_HPP
+#define _KINEMATICS_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stddef.h>
+
+#include "Robot.cpp"
+#include "SimdMath.hpp"
+
+// forward kinematics for a leg chain.
+//
+// every joint is a rotation about a fixed axis, and the next joint sits at connectOffset from it, so
+// the frame of segment j is
+//     frame[0] = legBase * R(angle0, axis0)
+//     frame[j] = frame[j - 1] * T(connectOffset[j - 1]) * R(angle[j], axis[j])
+// where legBase = T(leg.baseOffset) * R(leg.baseRotationAngle, leg.baseRotationAxis).
+// everything here treats a leg as a plain chain, each part hanging off the one before it
+
+// reference version using glm. writes one frame per segment of the leg into out
+inline void legSegmentTransforms(const Robot& robot, int legIndex, glm::mat4* out) {
+    const Robot::leg& l = robot.legs[legIndex];
+    const Robot::legPart* parts = &robot.segments[l.firstSegment];
+
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), l.baseOffset);
+    m = glm::rotate(m, l.baseRotationAngle, l.baseRotationAxis);
+
+    for (int j = 0; j < l.numSegments; j++) {
+        if (j != 0) { // no offset for first part
+            m = glm::translate(m, parts[j - 1].connectOffset);
+        }
+        m = glm::rotate(m, parts[j].jointAngle, parts[j].jointAxis);
+        out[j] = m;
+    }
+}
+
+// everything about a leg that doesn't change with its joint angles, precomputed for the batch kernel.
+// matrices are affine 3x4, column major: elements 0-8 are the rotation, 9-11 the translation
+struct LegChainConstants {
+    int numSegments;
+    float base[12];
+    // rotation about a fixed unit axis n is R = n n^T + cos(a) (I - n n^T) + sin(a) [n]x,
+    // so only cos and sin are per lane
+    float axisOuter[maxLegSegments][9];
+    float axisCos[maxLegSegments][9];
+    float axisSin[maxLegSegments][9];
+    float connectOffset[maxLegSegments][3];
+
+    LegChainConstants() {}
+
+    LegChainConstants(const Robot& robot, int legIndex) {
+        const Robot::leg& l = robot.legs[legIndex];
+        const Robot::legPart* parts = &robot.segments[l.firstSegment];
+        numSegments = l.numSegments;
+        // Robot only builds plain chains that fit, but everything here depends on it
+        assert(numSegments <= maxLegSegments);
+        for (int s = 1; s < numSegments; s++) {
+            assert(robot.parentSegment[l.firstSegment + s] == l.firstSegment + s - 1);
+        }
+
+        glm::mat4 b = glm::translate(glm::mat4(1.0f), l.baseOffset);
+        b = glm::rotate(b, l.baseRotationAngle, l.baseRotationAxis);
+        for (int col = 0; col < 4; col++) {
+            for (int row = 0; row < 3; row++) {
+                base[col * 3 + row] = b[col][row];
+            }
+        }
+
+        for (int s = 0; s < numSegments; s++) {
+            glm::vec3 n = glm::normalize(parts[s].jointAxis);
+            float cross[3][3] = { // [n]x, indexed [col][row]
+                {0.0f, n.z, -n.y},
+                {-n.z, 0.0f, n.x},
+                {n.y, -n.x, 0.0f}
+            };
+            for (int col = 0; col < 3; col++) {
+                for (int row = 0; row < 3; row++) {
+                    float outer = n[row] * n[col];
+                    axisOuter[s][col * 3 + row] = outer;
+                    axisCos[s][col * 3 + row] = (row == col ? 1.0f : 0.0f) - outer;
+                    axisSin[s][col * 3 + row] = cross[col][row];
+                }
+            }
+            for (int k = 0; k < 3; k++) {
+                connectOffset[s][k] = parts[s].connectOffset[k];
+            }
+        }
+    }
+};
+
+// one group of V::width chains. angles and out are structure-of-arrays with the given stride:
+// angle of segment s for chain i is angles[s * stride + i], and element e of the frame of segment s
+// is out[(s * 12 + e) * stride + i]
+template <class V>
+inline void legChainFKLanes(const LegChainConstants& k, const float* angles, float* out, size_t i, size_t stride) {
+    typedef typename V::F F;
+
+    F rot[9], pos[3];
+    for (int e = 0; e < 9; e++) rot[e] = V::set1(k.base[e]);
+    for (int r = 0; r < 3; r++) pos[r] = V::set1(k.base[9 + r]);
+
+    for (int s = 0; s < k.numSegments; s++) {
+        if (s != 0) { // move to the end of the previous part
+            const float* o = k.connectOffset[s - 1];
+            for (int r = 0; r < 3; r++) {
+                F p = V::madd(rot[r], V::set1(o[0]), pos[r]);
+                p = V::madd(rot[3 + r], V::set1(o[1]), p);
+                pos[r] = V::madd(rot[6 + r], V::set1(o[2]), p);
+            }
+        }
+
+        F sinA, cosA;
+        simd::sincos<V>(V::load(angles + s * stride + i), sinA, cosA);
+
+        F joint[9];
+        for (int e = 0; e < 9; e++) {
+            joint[e] = V::madd(V::set1(k.axisSin[s][e]), sinA,
+                               V::madd(V::set1(k.axisCos[s][e]), cosA, V::set1(k.axisOuter[s][e])));
+        }
+
+        F next[9];
+        for (int col = 0; col < 3; col++) {
+            for (int r = 0; r < 3; r++) {
+                F v = V::mul(rot[r], joint[col * 3]);
+                v = V::madd(rot[3 + r], joint[col * 3 + 1], v);
+                next[col * 3 + r] = V::madd(rot[6 + r], joint[col * 3 + 2], v);
+            }
+        }
+
+        float* segOut = out + (size_t)s * 12 * stride + i;
+        for (int e = 0; e < 9; e++) {
+            rot[e] = next[e];
+            V::store(segOut + e * stride, rot[e]);
+        }
+        for (int r = 0; r < 3; r++) {
+            V::store(segOut + (9 + r) * stride, pos[r]);
+        }
+    }
+}
+
+// forward kinematics for count chains of the same leg, 8 (avx2) or 4 (sse) at a time, scalar for the rest
+inline void legChainFKBatch(const LegChainConstants& k, const float* angles, float* out, size_t count, size_t stride) {
+    size_t i = 0;
+#ifdef GLPLAY_SIMD_AVX
+    for (; i + 8 <= count; i += 8) legChainFKLanes<simd::AvxLanes>(k, angles, out, i, stride);
+#endif
+#ifdef GLPLAY_SIMD_SSE
+    for (; i + 4 <= count; i += 4) legChainFKLanes<simd::SseLanes>(k, angles, out, i, stride);
+#endif
+    for (; i < count; i++) legChainFKLanes<simd::ScalarLanes>(k, angles, out, i, stride);
+}
+
+// expands one frame from batch output back into a glm matrix
+inline glm::mat4 legChainFrame(const float* out, int segment, size_t i, size_t stride) {
+    glm::mat4 m(1.0f);
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 3; row++) {
+            m[col][row] = out[((size_t)segment * 12 + col * 3 + row) * stride + i];
+        }
+    }
+    return m;
+}
+
+// inverse kinematics for the 3 part yaw/pitch/pitch leg built in the Robot() constructor: segment 0 turns
+// about the leg's y axis, segments 1 and 2 pitch about their z axes, and every connectOffset points along x.
+// with that layout the foot always lies in the vertical plane picked by the yaw joint, so the solution is
+// the yaw angle plus a two link planar problem, both closed form
+
+enum IK_Result {
+    IK_SOLVED,
+    IK_OUT_OF_REACH, // no pose of the leg puts the foot there, even ignoring joint limits
+    IK_OUTSIDE_LIMITS // reachable, but only with joint angles outside their limits
+};
+
+inline float wrapAngle(float a) {
+    const float PI = glm::pi<float>();
+    if (a > PI) a -= 2.0f * PI;
+    if (a < -PI) a += 2.0f * PI;
+    return a;
+}
+
+// how far outside their limits a set of joint angles is, 0 if within all of them
+inline float legLimitViolation(const Robot::legPart* parts, const float angles[3]) {
+    float violation = 0.0f;
+    for (int j = 0; j < 3; j++) {
+        violation += glm::max(0.0f, parts[j].minJointAngle - angles[j]);
+        violation += glm::max(0.0f, angles[j] - parts[j].maxJointAngle);
+    }
+    return violation;
+}
+
+// foot position where the end of the last segment lands, in the same frame as legSegmentTransforms
+inline glm::vec3 legFootPosition(const Robot& robot, int legIndex) {
+    const Robot::leg& l = robot.legs[legIndex];
+    glm::mat4 frames[maxLegSegments];
+    legSegmentTransforms(robot, legIndex, frames);
+    int last = l.numSegments - 1;
+    return glm::vec3(frames[last] * glm::vec4(robot.segments[l.firstSegment + last].connectOffset, 1.0f));
+}
+
+// solves for joint angles that put the foot at target (same frame as legFootPosition).
+// on IK_SOLVED, angles holds the solution. on IK_OUTSIDE_LIMITS it holds the closest solution clamped to
+// the limits, and on IK_OUT_OF_REACH it is left untouched
+inline IK_Result solveLegIK(const Robot& robot, int legIndex, glm::vec3 target, float angles[3]) {
+    const Robot::leg& l = robot.legs[legIndex];
+    assert(l.numSegments == 3);
+    const Robot::legPart* parts = &robot.segments[l.firstSegment];
+
+    // move the target into the leg's own frame
+    glm::vec3 p = target - l.baseOffset;
+    p = glm::vec3(glm::rotate(glm::mat4(1.0f), -l.baseRotationAngle, l.baseRotationAxis) * glm::vec4(p, 1.0f));
+
+    float hipLength = glm::length(parts[0].connectOffset);
+    float upperLength = glm::length(parts[1].connectOffset);
+    float lowerLength = glm::length(parts[2].connectOffset);
+
+    // yaw about y takes (r, h, 0) to (r cos, h, -r sin). the leg can reach either facing the target,
+    // or facing away from it with the hip pointing backwards, so try both
+    float horizontal = glm::sqrt(p.x * p.x + p.z * p.z);
+    float yaw = (horizontal > 0.0f) ? atan2f(-p.z, p.x) : 0.0f;
+
+    float best[3];
+    float bestViolation = -1.0f;
+
+    for (int facing = 0; facing < 2; facing++) {
+        float r = (facing == 0) ? horizontal : -horizontal;
+        float u = r - hipLength; // foot relative to the first pitch joint, in the leg plane
+        float v = p.y;
+
+        float cosKnee = (u * u + v * v - upperLength * upperLength - lowerLength * lowerLength) / (2.0f * upperLength * lowerLength);
+        if (cosKnee < -1.0f - 1e-5f || cosKnee > 1.0f + 1e-5f) {
+            continue;
+        }
+        cosKnee = glm::clamp(cosKnee, -1.0f, 1.0f); // a fully straight leg can land a rounding error outside
+
+        // knee bent either way
+        for (int bend = 0; bend < 2; bend++) {
+            float knee = (bend == 0) ? acosf(cosKnee) : -acosf(cosKnee);
+            float candidate[3];
+            candidate[0] = wrapAngle(facing == 0 ? yaw : yaw + glm::pi<float>());
+            candidate[1] = wrapAngle(atan2f(v, u) - atan2f(lowerLength * sinf(knee), upperLength + lowerLength * cosf(knee)));
+            candidate[2] = knee;
+
+            float violation = legLimitViolation(parts, candidate);
+            if (bestViolation < 0.0f || violation < bestViolation) {
+                bestViolation = violation;
+                best[0] = candidate[0]; best[1] = candidate[1]; best[2] = candidate[2];
+            }
+        }
+    }
+
+    if (bestViolation < 0.0f) {
+        return IK_OUT_OF_REACH;
+    }
+
+    for (int j = 0; j < 3; j++) {
+        angles[j] = glm::clamp(best[j], parts[j].minJointAngle, parts[j].maxJointAngle);
+    }
+    return bestViolation == 0.0f ? IK_SOLVED : IK_OUTSIDE_LIMITS;
+}
+
+// solves IK for one leg of a robot and drives its motors there, if the target is reachable
+inline IK_Result setFootTarget(Robot& robot, int legIndex, glm::vec3 target) {
+    float angles[3];
+    IK_Result result = solveLegIK(robot, legIndex, target, angles);
+    if (result != IK_OUT_OF_REACH) {
+        for (int j = 0; j < 3; j++) {
+            robot.setMotorAngle(legIndex, j, angles[j]);
+        }
+    }
+    return result;
+}
+
+// everything the batch IK needs about a leg, precomputed once
+struct LegIKConstants {
+    float toLeg[9]; // rotation from the robot frame into the leg frame, column major
+    float baseOffset[3];
+    float hipLength, upperLength, lowerLength;
+    float minAngle[3], maxAngle[3];
+    // squared bounds used to reject targets before any trig: a sphere around the leg base, and the
+    // annulus the two pitch links can reach around the first pitch joint (with the same slack as solveLegIK)
+    float maxReachSq;
+    float planarMinSq, planarMaxSq;
+
+    LegIKConstants() {}
+
+    LegIKConstants(const Robot& robot, int legIndex) {
+        const Robot::leg& l = robot.legs[legIndex];
+        assert(l.numSegments == 3);
+        const Robot::legPart* parts = &robot.segments[l.firstSegment];
+
+        glm::mat4 r = glm::rotate(glm::mat4(1.0f), -l.baseRotationAngle, l.baseRotationAxis);
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) {
+                toLeg[col * 3 + row] = r[col][row];
+            }
+            baseOffset[col] = l.baseOffset[col];
+        }
+
+        hipLength = glm::length(parts[0].connectOffset);
+        upperLength = glm::length(parts[1].connectOffset);
+        lowerLength = glm::length(parts[2].connectOffset);
+        for (int j = 0; j < 3; j++) {
+            minAngle[j] = parts[j].minJointAngle;
+            maxAngle[j] = parts[j].maxJointAngle;
+        }
+
+        float reach = hipLength + upperLength + lowerLength;
+        float slack = 2.0f * upperLength * lowerLength * 1e-5f;
+        maxReachSq = reach * reach;
+        planarMinSq = (upperLength - lowerLength) * (upperLength - lowerLength) - slack;
+        planarMaxSq = (upperLength + lowerLength) * (upperLength + lowerLength) + slack;
+    }
+};
+
+// one group of V::width targets for solveLegIKBatch. returns false if the whole group was rejected by the
+// reach bounds, in which case no trig was done
+template <class V>
+inline bool legIKLanes(const LegIKConstants& k, const float* tx, const float* ty, const float* tz,
+                       float* angles, int32_t* status, size_t i, size_t stride) {
+    typedef typename V::F F;
+    typedef typename V::I I;
+
+    // target in the leg frame
+    F dx = V::sub(V::load(tx + i), V::set1(k.baseOffset[0]));
+    F dy = V::sub(V::load(ty + i), V::set1(k.baseOffset[1]));
+    F dz = V::sub(V::load(tz + i), V::set1(k.baseOffset[2]));
+    F p[3];
+    for (int r = 0; r < 3; r++) {
+        p[r] = V::madd(V::set1(k.toLeg[6 + r]), dz, V::madd(V::set1(k.toLeg[3 + r]), dy, V::mul(V::set1(k.toLeg[r]), dx)));
+    }
+
+    // cheapest test first: nothing outside the sphere around the leg base is reachable
+    I outOfReach = V::set1i(IK_OUT_OF_REACH);
+    F horizontalSq = V::madd(p[0], p[0], V::mul(p[2], p[2]));
+    I inSphere = V::lessEqual(V::madd(p[1], p[1], horizontalSq), V::set1(k.maxReachSq));
+    if (!V::any(inSphere)) {
+        V::storei(status + i, outOfReach);
+        return false;
+    }
+
+    // then the planar annulus, for the leg facing the target and facing away from it
+    F horizontal = V::sqrt(horizontalSq);
+    F u[2], dist2[2];
+    I reachable[2];
+    for (int facing = 0; facing < 2; facing++) {
+        F r = (facing == 0) ? horizontal : V::sub(V::set1(0.0f), horizontal);
+        u[facing] = V::sub(r, V::set1(k.hipLength));
+        dist2[facing] = V::madd(u[facing], u[facing], V::mul(p[1], p[1]));
+        I inside = V::andi(V::lessEqual(V::set1(k.planarMinSq), dist2[facing]), V::lessEqual(dist2[facing], V::set1(k.planarMaxSq)));
+        reachable[facing] = V::andi(inside, inSphere);
+    }
+    if (!V::any(V::ori(reachable[0], reachable[1]))) {
+        V::storei(status + i, outOfReach);
+        return false;
+    }
+
+    F yaw = simd::atan2<V>(V::sub(V::set1(0.0f), p[2]), p[0]);
+    F yawFlipped = V::select(V::less(V::set1(0.0f), yaw), V::sub(yaw, V::set1(simd::pi)), V::add(yaw, V::set1(simd::pi)));
+
+    float L1 = k.upperLength, L2 = k.lowerLength;
+    const float noSolution = 1e30f;
+    F bestViolation = V::set1(noSolution);
+    F best[3] = {V::set1(0.0f), V::set1(0.0f), V::set1(0.0f)};
+
+    // same candidate order as solveLegIK, so both pick the same one
+    for (int facing = 0; facing < 2; facing++) {
+        F cosKnee = V::mul(V::sub(dist2[facing], V::set1(L1 * L1 + L2 * L2)), V::set1(1.0f / (2.0f * L1 * L2)));
+        cosKnee = V::max(V::set1(-1.0f), V::min(cosKnee, V::set1(1.0f)));
+        F knee = simd::acos<V>(cosKnee);
+        F sinKnee = V::sqrt(V::max(V::set1(0.0f), V::madd(V::sub(V::set1(0.0f), cosKnee), cosKnee, V::set1(1.0f))));
+        F v = p[1];
+
+        for (int bend = 0; bend < 2; bend++) {
+            I flip = V::set1i(bend == 0 ? 0 : (int32_t)0x80000000);
+            F candidate[3];
+            candidate[0] = (facing == 0) ? yaw : yawFlipped;
+            candidate[2] = V::xorSign(knee, flip);
+
+            // atan2(v, u) - atan2(L2 sin, L1 + L2 cos) as a single atan2
+            F a = V::madd(V::set1(L2), cosKnee, V::set1(L1));
+            F b = V::xorSign(V::mul(V::set1(L2), sinKnee), flip);
+            candidate[1] = simd::atan2<V>(V::sub(V::mul(v, a), V::mul(u[facing], b)), V::madd(u[facing], a, V::mul(v, b)));
+
+            F violation = V::set1(0.0f);
+            for (int j = 0; j < 3; j++) {
+                violation = V::add(violation, V::max(V::set1(0.0f), V::sub(V::set1(k.minAngle[j]), candidate[j])));
+                violation = V::add(violation, V::max(V::set1(0.0f), V::sub(candidate[j], V::set1(k.maxAngle[j]))));
+            }
+
+            I better = V::andi(reachable[facing], V::less(violation, bestViolation));
+            bestViolation = V::select(better, violation, bestViolation);
+            for (int j = 0; j < 3; j++) {
+                best[j] = V::select(better, candidate[j], best[j]);
+            }
+        }
+    }
+
+    I found = V::less(bestViolation, V::set1(noSolution));
+    for (int j = 0; j < 3; j++) {
+        F clamped = V::max(V::set1(k.minAngle[j]), V::min(best[j], V::set1(k.maxAngle[j])));
+        float* out = angles + j * stride + i;
+        V::store(out, V::select(found, clamped, V::load(out))); // unreachable targets leave angles untouched
+    }
+    I solved = V::selecti(V::lessEqual(bestViolation, V::set1(0.0f)), V::set1i(IK_SOLVED), V::set1i(IK_OUTSIDE_LIMITS));
+    V::storei(status + i, V::selecti(found, solved, outOfReach));
+    return true;
+}
+
+// solves IK for count foot targets of the same leg, 8 (avx2) or 4 (sse) at a time. targets are given per
+// component, angles are written structure-of-arrays (joint j of target i at angles[j * stride + i]) and
+// status[i] gets the IK_Result of each target, with the same meaning as for solveLegIK.
+// returns how many targets were rejected by the reach bounds without doing any trig
+inline size_t solveLegIKBatch(const LegIKConstants& k, const float* tx, const float* ty, const float* tz,
+                              float* angles, int32_t* status, size_t count, size_t stride) {
+    size_t rejected = 0;
+    size_t i = 0;
+#ifdef GLPLAY_SIMD_AVX
+    for (; i + 8 <= count; i += 8) rejected += legIKLanes<simd::AvxLanes>(k, tx, ty, tz, angles, status, i, stride) ? 0 : 8;
+#endif
+#ifdef GLPLAY_SIMD_SSE
+    for (; i + 4 <= count; i += 4) rejected += legIKLanes<simd::SseLanes>(k, tx, ty, tz, angles, status, i, stride) ? 0 : 4;
+#endif
+    for (; i < count; i++) rejected += legIKLanes<simd::ScalarLanes>(k, tx, ty, tz, angles, status, i, stride) ? 0 : 1;
+    return rejected;
+}
+
+#endif /* Kinematics.hpp */
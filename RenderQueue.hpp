@@ -0,0 +1,157 @@
+#ifndef _RENDERQUEUE_HPP
+#define _RENDERQUEUE_HPP
+
+#include <glm/glm.hpp>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "Shader.hpp"
+#include "GLState.hpp"
+#include "InstanceRenderer.hpp"
+
+// what a surface looks like, past its per instance color. set as the shader's material uniforms
+struct material {
+    float shininess;
+};
+
+// a frame's draws, collected up front and sorted so draws sharing state end up next to each other before
+// any of them reach gl. each draw gets a 64 bit key, most significant first:
+//
+//   program (8 bits) | mesh (12 bits) | material (12 bits) | depth (32 bits)
+//
+// so the sort groups by program first, since switching those costs the most, then by mesh and material,
+// and draws with the same state go front to back so the depth test throws away as much as it can.
+// submitting walks the sorted draws and only touches state that changed from the draw before
+class RenderQueue {
+public:
+    // program changes and material uploads in the last submit, the rest were skipped
+    int programChanges = 0;
+    int materialChanges = 0;
+
+    // returns the id to queue draws with
+    int addMaterial(const material& m) {
+        assert(materials.size() < (1 << materialBits)); // has to fit its field of the key
+        materials.push_back(m);
+        return materials.size() - 1;
+    }
+
+    // queues instances [firstInstance, firstInstance + count) of the renderer's current frame as the
+    // given mesh. depth is the distance from the camera, for ordering draws that share state
+    void add(Shader& shader, int meshId, int materialId, float depth, int firstInstance = 0, int count = -1) {
+        assert(meshId >= 0 && meshId < (1 << meshBits));
+        assert(materialId >= 0 && materialId < (int)materials.size());
+        int program = programSlot(shader);
+        items.push_back({makeKey(program, meshId, materialId, depth), program, meshId, materialId, firstInstance, count});
+    }
+
+    int size() const {
+        return items.size();
+    }
+
+    // sorts and draws everything queued, then empties the queue
+    void submit(InstanceRenderer& renderer) {
+        sortItems();
+        programChanges = 0;
+        materialChanges = 0;
+        int lastProgram = -1, lastMaterial = -1;
+        for (int index : order) {
+            const drawItem& item = items[index];
+            programSlotInfo& program = programs[item.program];
+            if (item.program != lastProgram) {
+                program.shader->use();
+                programChanges++;
+                lastProgram = item.program;
+                lastMaterial = -1; // uniforms belong to the program, so whatever was set was set on another one
+            }
+            if (item.material != lastMaterial) {
+                program.shader->set(program.shininess, materials[item.material].shininess);
+                materialChanges++;
+                lastMaterial = item.material;
+            }
+            renderer.draw(item.meshId, item.firstInstance, item.count);
+        }
+        items.clear();
+    }
+
+private:
+    // key field widths, see the class comment. ids past these would bleed into their neighbours
+    static const int programBits = 8;
+    static const int meshBits = 12;
+    static const int materialBits = 12;
+
+    struct drawItem {
+        uint64_t key;
+        int program; // slot in programs
+        int meshId;
+        int material;
+        int firstInstance;
+        int count;
+    };
+
+    // programs get small slots in the order they're first queued, so they fit in the key.
+    // their material uniforms are looked up once, here
+    struct programSlotInfo {
+        Shader* shader;
+        Shader::Uniform<float> shininess;
+    };
+
+    std::vector<drawItem> items;
+    std::vector<programSlotInfo> programs;
+    std::vector<material> materials;
+    std::vector<int> order; // items, sorted by key
+    std::vector<int> scratch;
+
+    int programSlot(Shader& shader) {
+        for (size_t i = 0; i < programs.size(); i++) {
+            if (programs[i].shader == &shader) return i;
+        }
+        assert(programs.size() < (1 << programBits));
+        programs.push_back({&shader, shader.uniform<float>("material.shininess")});
+        return programs.size() - 1;
+    }
+
+    static uint64_t makeKey(int program, int meshId, int materialId, float depth) {
+        // for depths >= 0 the float's bits sort the same way as the floats themselves
+        depth = glm::max(depth, 0.0f);
+        uint32_t depthBits;
+        memcpy(&depthBits, &depth, sizeof(depthBits));
+        return ((uint64_t)(program & 0xFF) << 56) | ((uint64_t)(meshId & 0xFFF) << 44)
+            | ((uint64_t)(materialId & 0xFFF) << 32) | depthBits;
+    }
+
+    // least significant digit first radix sort on the keys, a byte per pass. stable, so draws with equal
+    // keys stay in the order they were queued. passes where every key has the same byte change nothing and
+    // are skipped, which with a handful of programs and meshes is most of the top half
+    void sortItems() {
+        int n = items.size();
+        order.resize(n);
+        scratch.resize(n);
+        for (int i = 0; i < n; i++) order[i] = i;
+
+        for (int shift = 0; shift < 64; shift += 8) {
+            int counts[256] = {};
+            for (int i = 0; i < n; i++) {
+                counts[(items[i].key >> shift) & 0xFF]++;
+            }
+            if (n == 0 || counts[(items[0].key >> shift) & 0xFF] == n) {
+                continue;
+            }
+            int offset = 0;
+            for (int b = 0; b < 256; b++) {
+                int c = counts[b];
+                counts[b] = offset;
+                offset += c;
+            }
+            for (int i = 0; i < n; i++) {
+                int index = order[i];
+                scratch[counts[(items[index].key >> shift) & 0xFF]++] = index;
+            }
+            order.swap(scratch);
+        }
+    }
+};
+
+#endif /* RenderQueue.hpp */
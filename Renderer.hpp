@@ -3,6 +3,9 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <vector>
 
 struct shape {
     glm::vec3 dimensions; // length, width, height of rectangular prism
@@ -10,4 +13,86 @@ struct shape {
     glm::vec3 color; // 0-1 rgb
 };
 
+// a shape the way the instanced shader takes it. this is the exact layout of the gpu instance buffer, so
+// it can be written straight into mapped memory
+struct shapeInstance {
+    glm::mat4 model; // transformation scaled by dimensions
+    glm::vec3 color;
+    glm::mat3 normalMatrix; // transpose(inverse(mat3(model))), so the vertex shader doesn't have to
+};
+
+// the normal matrix of a model matrix. shapes are a rotation times a scale, whose columns are
+// orthogonal, and then the inverse transpose is just each column divided by its squared length.
+// anything else (shear) gets the full inverse
+inline glm::mat3 shapeNormalMatrix(const glm::mat4& model) {
+    glm::vec3 c0 = glm::vec3(model[0]), c1 = glm::vec3(model[1]), c2 = glm::vec3(model[2]);
+    float l0 = glm::dot(c0, c0), l1 = glm::dot(c1, c1), l2 = glm::dot(c2, c2);
+    float tolerance = 1e-5f * glm::max(l0, glm::max(l1, l2));
+    if (glm::abs(glm::dot(c0, c1)) > tolerance || glm::abs(glm::dot(c0, c2)) > tolerance || glm::abs(glm::dot(c1, c2)) > tolerance) {
+        return glm::inverseTranspose(glm::mat3(model));
+    }
+    return glm::mat3(c0 / l0, c1 / l1, c2 / l2);
+}
+
+inline void writeShapeInstance(shapeInstance& out, const glm::mat4& transformation, const glm::vec3& dimensions, const glm::vec3& color) {
+    // same as glm::scale(transformation, dimensions): scale the first three columns
+    out.model = glm::mat4(transformation[0] * dimensions.x, transformation[1] * dimensions.y, transformation[2] * dimensions.z, transformation[3]);
+    out.color = color;
+    out.normalMatrix = shapeNormalMatrix(out.model);
+}
+
+// a shape part way from a to b, t in [0, 1]. meant for two states one small simulation step apart, so the
+// finished matrices are blended directly instead of blending the pose and redoing the kinematics. a blend
+// of two rotated columns comes out a little short, so each is stretched back to the blended length of the
+// two, which keeps shapes from shrinking as they turn. the columns also come out a little off square, a
+// shear of roughly t (1 - t) (1 - cos(angle)) for the angle turned in the step: a few hundredths of a
+// degree at 240 Hz, but several degrees for a full radian a step, so this is only good at high sim rates.
+// the normal matrix takes the shear into account. the color is b's
+inline void interpolateShapeInstance(shapeInstance& out, const shapeInstance& a, const shapeInstance& b, float t) {
+    for (int col = 0; col < 3; col++) {
+        glm::vec3 ca = glm::vec3(a.model[col]), cb = glm::vec3(b.model[col]);
+        glm::vec3 c = glm::mix(ca, cb, t);
+        float length = glm::length(c);
+        float target = glm::mix(glm::length(ca), glm::length(cb), t);
+        out.model[col] = glm::vec4(length > 0.0f ? c * (target / length) : c, 0.0f);
+    }
+    out.model[3] = glm::mix(a.model[3], b.model[3], t);
+    out.color = b.color;
+    out.normalMatrix = shapeNormalMatrix(out.model);
+}
+
+// a triangle mesh on the cpu side, before it goes into a GeometryRegistry
+struct meshData {
+    std::vector<float> vertices; // position then normal, 6 floats per vertex
+    std::vector<unsigned int> indices; // 3 per triangle, counter clockwise seen from outside
+};
+
+// the unit cube every shape is drawn as, scaled by its dimensions. each face needs its own normal, so the
+// corners can't be shared between faces, but within a face they can: 4 vertices and 2 triangles per face,
+// 24 vertices and 36 indices in all
+inline meshData buildBoxMesh() {
+    meshData mesh;
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side = 0; side < 2; side++) {
+            float sign = side == 0 ? -1.0f : 1.0f;
+            glm::vec3 normal(0.0f);
+            normal[axis] = sign;
+            // u x v points along +axis, so swap them on the negative face to keep the winding outward
+            int b = (axis + 1) % 3, c = (axis + 2) % 3;
+            glm::vec3 u(0.0f), v(0.0f);
+            u[side == 1 ? b : c] = 1.0f;
+            v[side == 1 ? c : b] = 1.0f;
+
+            unsigned int first = mesh.vertices.size() / 6;
+            const float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+            for (int corner = 0; corner < 4; corner++) {
+                glm::vec3 p = 0.5f * (normal + corners[corner][0] * u + corners[corner][1] * v);
+                mesh.vertices.insert(mesh.vertices.end(), {p.x, p.y, p.z, normal.x, normal.y, normal.z});
+            }
+            mesh.indices.insert(mesh.indices.end(), {first, first + 1, first + 2, first + 2, first + 3, first});
+        }
+    }
+    return mesh;
+}
+
 #endif /* Renderer.hpp */
\ No newline at end of file
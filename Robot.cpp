@@ -1,9 +1,33 @@
+#ifndef _ROBOT_CPP
+#define _ROBOT_CPP
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <assert.h>
+#include <vector>
+
+// the most segments a leg can have. the batch kernels keep a whole leg's chain in fixed size arrays
+const int maxLegSegments = 8;
+
+// the parts of each leg of the standard robot, from the body out. plain floats so they are usable at
+// compile time: Robot() and StaticRobot both build from this one table
+struct standardLegPart {
+    float jointAxis[3];
+    float minJointAngle;
+    float maxJointAngle;
+    float connectOffset[3];
+    float dimensions[3];
+    float baseOffset[3];
+};
+constexpr float standardPI = 3.14159265358979323846f;
+constexpr standardLegPart standardLegParts[3] = {
+    {{0,1,0},-standardPI,standardPI,{1.0f,0,0},{1.0f,1.0f,1.0f},{0.5f,0.0f,0.0f}},
+    {{0,0,1},-standardPI/2,standardPI/2,{3.0f,0,0},{3.0f,1.0f,1.0f},{1.5f,0.0f,0.0f}},
+    {{0,0,1},-standardPI/4,standardPI/4,{3.0f,0,0},{3.0f,1.0f,1.0f},{1.5f,0.0f,0.0f}}
+};
+
 class Robot {
-private:
-    float PI = glm::pi<float>();
 public:
     // each part is represented as a line between it's origin and joint at the end/contact point
     // (0,0,0) is origin
@@ -16,43 +40,205 @@ public:
         glm::vec3 dimensions; // the shape of the part
         glm::vec3 baseOffset; // the offset needed to make the model dimensions line up with the joints
     };
-    // a leg is just a series of parts
+    // a leg is a series of parts attached to the body. its parts are stored next to each other in segments
     struct leg {
-        legPart segments[3];
+        int firstSegment;
+        int numSegments;
         glm::vec3 baseRotationAxis;
         float baseRotationAngle;
         glm::vec3 baseOffset;
     };
 
-    leg legs[1];
+    // the whole kinematic tree, flattened into arrays indexed by segment. every leg is a plain chain, so a
+    // segment's parent is the one before it in the same leg, or -1 if it attaches straight to the body. traversalOrder visits every
+    // segment after its parent, so a single pass over it computes every transform
+    std::vector<legPart> segments;
+    std::vector<int> parentSegment;
+    std::vector<int> segmentLeg;
+    std::vector<int> segmentDepth; // number of joints between the segment and the body, 0 for a leg's first part
+    std::vector<int> traversalOrder;
+
+    std::vector<leg> legs;
+
+    glm::vec3 bodyDimensions = glm::vec3(1.0f);
 
-    Robot() {
-        legPart p0 = {glm::vec3(0,1,0),-PI,PI,0,glm::vec3(1.0f,0,0),glm::vec3(1.0f,1.0f,1.0f),glm::vec3(0.5f,0.0f,0.0f)};
-        legPart p1 = {glm::vec3(0,0,1),-PI/2,PI/2,0,glm::vec3(3.0f,0,0),glm::vec3(3.0f,1.0f,1.0f),glm::vec3(1.5f,0.0f,0.0f)};
-        legPart p2 = {glm::vec3(0,0,1),-PI/4,PI/4,0,glm::vec3(3.0f,0,0),glm::vec3(3.0f,1.0f,1.0f),glm::vec3(1.5f,0.0f,0.0f)};
+    // the standard hexapod
+    Robot() : Robot(6, 2.0f) {}
+
+    // a walker with numLegs identical legs spread evenly around a body of the given radius.
+    // leg 0 points along +x and the rest follow counterclockwise seen from above
+    Robot(int numLegs, float bodyRadius) {
+        const float PI = glm::pi<float>();
+
+        bodyDimensions = glm::vec3(2.0f * bodyRadius, 1.0f, 2.0f * bodyRadius);
+
+        for (int i = 0; i < numLegs; i++) {
+            float angle = 2.0f * PI * i / numLegs;
+            addLeg(glm::vec3(0,1,0), angle, glm::vec3(bodyRadius * glm::cos(angle), 0.0f, -bodyRadius * glm::sin(angle)));
+            for (const standardLegPart& p : standardLegParts) {
+                legPart part = {glm::vec3(p.jointAxis[0], p.jointAxis[1], p.jointAxis[2]), p.minJointAngle, p.maxJointAngle, 0,
+                    glm::vec3(p.connectOffset[0], p.connectOffset[1], p.connectOffset[2]),
+                    glm::vec3(p.dimensions[0], p.dimensions[1], p.dimensions[2]),
+                    glm::vec3(p.baseOffset[0], p.baseOffset[1], p.baseOffset[2])};
+                addSegment(part);
+            }
+        }
+
+        finalize();
+    }
 
-        leg l0 = {{p0,p1,p2},glm::vec3(0,1,0),0,glm::vec3(0,0,0)};
+    // building a robot by hand: add a leg, then its segments, then the next leg, and call finalize() at the end
+    int addLeg(glm::vec3 baseRotationAxis, float baseRotationAngle, glm::vec3 baseOffset) {
+        leg l = {(int)segments.size(), 0, baseRotationAxis, baseRotationAngle, baseOffset};
+        legs.push_back(l);
+        return legs.size() - 1;
+    }
+
+    // adds a part to the end of the last leg added, hanging off its previous part (or the body if it is the
+    // first). legs are added whole and one after another, so each one's segments stay next to each other
+    int addSegment(const legPart& part) {
+        assert(!legs.empty());
+        int legIndex = legs.size() - 1;
+        leg& l = legs[legIndex];
+        assert(l.numSegments < maxLegSegments);
+        int parent = (l.numSegments == 0) ? -1 : (int)segments.size() - 1;
+        segments.push_back(part);
+        parentSegment.push_back(parent);
+        segmentLeg.push_back(legIndex);
+        segmentDepth.push_back(parent < 0 ? 0 : segmentDepth[parent] + 1);
+        l.numSegments++;
+        return segments.size() - 1;
+    }
+
+    // precomputes traversal order and sizes the transform cache. must be called after the last addSegment
+    void finalize() {
+        int numSegments = segments.size();
+        int numLegs = legs.size();
+
+        // shallowest first puts every parent before its children, and keeps legs together within a depth
+        traversalOrder.clear();
+        int maxDepth = 0;
+        for (int j = 0; j < numSegments; j++) maxDepth = glm::max(maxDepth, segmentDepth[j]);
+        for (int d = 0; d <= maxDepth; d++) {
+            for (int j = 0; j < numSegments; j++) {
+                if (segmentDepth[j] == d) traversalOrder.push_back(j);
+            }
+        }
+
+        // frames holds the legs' base transforms first and then the segments, so that every segment has a
+        // parent frame and an offset from it, and the update loop is the same for every segment
+        frames.assign(numLegs + numSegments, glm::mat4(1.0f));
+        parentFrame.resize(numSegments);
+        parentOffset.resize(numSegments);
+        for (int j = 0; j < numSegments; j++) {
+            int p = parentSegment[j];
+            parentFrame[j] = (p < 0) ? segmentLeg[j] : numLegs + p;
+            parentOffset[j] = (p < 0) ? glm::vec3(0.0f) : segments[p].connectOffset;
+        }
+        segmentDirty.assign(numSegments, 1);
+
+        markAllDirty();
+    }
+
+    int segmentIndex(int legIndex, int motorIndex) const {
+        return legs[legIndex].firstSegment + motorIndex;
+    }
 
-        legs[0] = l0;
+    legPart& getSegment(int legIndex, int motorIndex) {
+        return segments[segmentIndex(legIndex, motorIndex)];
+    }
+
+    const legPart& getSegment(int legIndex, int motorIndex) const {
+        return segments[segmentIndex(legIndex, motorIndex)];
     }
 
-    
     leg getLeg(int index) {
         return legs[index];
     }
 
     // returns true if it was successful, false if out of bounds
     bool setMotorAngle(int legIndex, int motorIndex, float newAngle) {
-        if (newAngle > legs[legIndex].segments[motorIndex].maxJointAngle) {
-            legs[legIndex].segments[motorIndex].jointAngle = legs[legIndex].segments[motorIndex].maxJointAngle;
-            return false;
+        return setJointAngle(segmentIndex(legIndex, motorIndex), newAngle);
+    }
+
+    // same as setMotorAngle, addressed by flat segment index
+    bool setJointAngle(int segment, float newAngle) {
+        legPart& part = segments[segment];
+        bool inBounds = true;
+        if (newAngle > part.maxJointAngle) {
+            newAngle = part.maxJointAngle;
+            inBounds = false;
+        }
+        if (newAngle < part.minJointAngle) {
+            newAngle = part.minJointAngle;
+            inBounds = false;
+        }
+        if (newAngle != part.jointAngle) {
+            part.jointAngle = newAngle;
+            markDirty(segment);
+        }
+        return inBounds;
+    }
+
+    // world transform of each segment's joint frame, cached between calls to updateKinematics.
+    // only joints changed since the last update (and the segments below them in the tree) are
+    // recomputed, and nothing at all if no joint moved.
+    // if you change jointAngle, offsets or the leg bases directly instead of through setMotorAngle,
+    // call markAllDirty() afterwards
+    void updateKinematics() {
+        if (!anyDirty) {
+            return;
+        }
+
+        int numLegs = legs.size();
+        for (size_t k = 0; k < traversalOrder.size(); k++) {
+            int j = traversalOrder[k];
+            int p = parentSegment[j];
+            if (p >= 0) segmentDirty[j] |= segmentDirty[p];
+            if (!segmentDirty[j]) {
+                continue;
+            }
+            glm::mat4 m = glm::translate(frames[parentFrame[j]], parentOffset[j]);
+            frames[numLegs + j] = glm::rotate(m, segments[j].jointAngle, segments[j].jointAxis);
+        }
+
+        for (size_t j = 0; j < segmentDirty.size(); j++) {
+            segmentDirty[j] = 0;
+        }
+        anyDirty = false;
+    }
+
+    // only valid after updateKinematics
+    const glm::mat4& getTransform(int segment) const {
+        return frames[legs.size() + segment];
+    }
+
+    const glm::mat4& getSegmentTransform(int legIndex, int motorIndex) const {
+        return getTransform(segmentIndex(legIndex, motorIndex));
+    }
+
+    void markDirty(int segment) {
+        segmentDirty[segment] = 1;
+        anyDirty = true;
+    }
+
+    void markAllDirty() {
+        for (size_t i = 0; i < legs.size(); i++) {
+            frames[i] = glm::translate(glm::mat4(1.0f), legs[i].baseOffset);
+            frames[i] = glm::rotate(frames[i], legs[i].baseRotationAngle, legs[i].baseRotationAxis);
         }
-        if (newAngle < legs[legIndex].segments[motorIndex].minJointAngle) {
-            legs[legIndex].segments[motorIndex].jointAngle = legs[legIndex].segments[motorIndex].minJointAngle;
-            return false;
+        for (size_t j = 0; j < segmentDirty.size(); j++) {
+            segmentDirty[j] = 1;
         }
-        legs[legIndex].segments[motorIndex].jointAngle = newAngle;
-        return true;
+        anyDirty = true;
     }
 
-};
\ No newline at end of file
+private:
+    std::vector<glm::mat4> frames; // leg bases, then segments
+    std::vector<int> parentFrame; // index into frames
+    std::vector<glm::vec3> parentOffset; // the parent's connectOffset, zero for a leg's first part
+    std::vector<char> segmentDirty;
+    bool anyDirty = true;
+};
+
+#endif /* Robot.cpp */
@@ -0,0 +1,197 @@
+#ifndef _ROBOTBATCH_CPP
+#define _ROBOTBATCH_CPP
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Robot.cpp"
+#include "Kinematics.hpp"
+#include "Dynamics.hpp"
+
+// many copies of the same robot, stored structure-of-arrays so that stepping thousands of them
+// is a handful of tight loops over contiguous floats instead of walking Robot structs.
+// every per-joint field is indexed by [segment * numRobots + robot], with segment the model's flat segment
+// index, so the same joint of consecutive robots is contiguous and can be processed several robots per
+// instruction
+class RobotBatch {
+public:
+    int numRobots;
+    int legsPerRobot;
+    int jointsPerRobot;
+
+    // joint state and limits
+    std::vector<float> jointAngle;
+    std::vector<float> minJointAngle;
+    std::vector<float> maxJointAngle;
+
+    // joint axis and connection offset, split per component
+    std::vector<float> jointAxisX, jointAxisY, jointAxisZ;
+    std::vector<float> connectOffsetX, connectOffsetY, connectOffsetZ;
+
+    // direction each joint is currently sweeping in for the demo motion (0 for joints that don't move)
+    std::vector<float> moveDir;
+
+    // for stepDynamics: joint velocities, the torques driving the joints, and the accelerations they gave
+    std::vector<float> jointVelocity;
+    std::vector<float> jointTorque;
+    std::vector<float> jointAcceleration;
+    glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f); // in the robot frame
+
+    // per leg constants for the forward kinematics kernel, the same for every robot
+    std::vector<LegChainConstants> legConstants;
+    std::vector<LegDynamicsConstants> legDynamics;
+    std::vector<int> legFirstSegment;
+    std::vector<int> legNumSegments;
+
+    // all storage is allocated here, once. nothing below allocates
+    RobotBatch(const Robot& model, int count) {
+        numRobots = count;
+        legsPerRobot = model.legs.size();
+        jointsPerRobot = model.segments.size();
+
+        size_t n = (size_t)numRobots * jointsPerRobot;
+        jointAngle.resize(n);
+        minJointAngle.resize(n);
+        maxJointAngle.resize(n);
+        jointAxisX.resize(n); jointAxisY.resize(n); jointAxisZ.resize(n);
+        connectOffsetX.resize(n); connectOffsetY.resize(n); connectOffsetZ.resize(n);
+        moveDir.resize(n);
+        jointVelocity.assign(n, 0.0f);
+        jointTorque.assign(n, 0.0f);
+        jointAcceleration.assign(n, 0.0f);
+
+        for (int l = 0; l < legsPerRobot; l++) {
+            legConstants.push_back(LegChainConstants(model, l));
+            legDynamics.push_back(LegDynamicsConstants(model, l));
+            legFirstSegment.push_back(model.legs[l].firstSegment);
+            legNumSegments.push_back(model.legs[l].numSegments);
+        }
+
+        for (int r = 0; r < numRobots; r++) {
+            for (int s = 0; s < jointsPerRobot; s++) {
+                const Robot::legPart& p = model.segments[s];
+                size_t j = (size_t)s * numRobots + r;
+                jointAngle[j] = p.jointAngle;
+                minJointAngle[j] = p.minJointAngle;
+                maxJointAngle[j] = p.maxJointAngle;
+                jointAxisX[j] = p.jointAxis.x;
+                jointAxisY[j] = p.jointAxis.y;
+                jointAxisZ[j] = p.jointAxis.z;
+                connectOffsetX[j] = p.connectOffset.x;
+                connectOffsetY[j] = p.connectOffset.y;
+                connectOffsetZ[j] = p.connectOffset.z;
+                moveDir[j] = (model.segmentDepth[s] == 0) ? 0.0f : 1.0f; // sweep every joint but the hips back and forth
+            }
+        }
+    }
+
+    size_t jointIndex(int robotIndex, int legIndex, int motorIndex) const {
+        return (size_t)(legFirstSegment[legIndex] + motorIndex) * numRobots + robotIndex;
+    }
+
+    size_t size() const {
+        return jointAngle.size();
+    }
+
+    // same semantics as Robot::setMotorAngle: clamps to the limits, returns false if it had to
+    bool setMotorAngle(int robotIndex, int legIndex, int motorIndex, float newAngle) {
+        size_t j = jointIndex(robotIndex, legIndex, motorIndex);
+        float clamped = glm::clamp(newAngle, minJointAngle[j], maxJointAngle[j]);
+        jointAngle[j] = clamped;
+        return clamped == newAngle;
+    }
+
+    // sets every joint of every robot at once. newAngles is laid out the same as jointAngle.
+    // returns how many joints had to be clamped
+    int setMotorAngles(const float* newAngles) {
+        size_t n = size();
+        float* angle = jointAngle.data();
+        const float* lo = minJointAngle.data();
+        const float* hi = maxJointAngle.data();
+
+        int numClamped = 0;
+        for (size_t j = 0; j < n; j++) {
+            float clamped = glm::min(glm::max(newAngles[j], lo[j]), hi[j]);
+            numClamped += (clamped != newAngles[j]);
+            angle[j] = clamped;
+        }
+        return numClamped;
+    }
+
+    // demo motion: every moving joint advances by deltaTime in its current direction, and bounces off
+    // its limits. written without branches so the compiler can vectorize it
+    void step(float deltaTime) {
+        size_t n = size();
+        float* angle = jointAngle.data();
+        float* dir = moveDir.data();
+        const float* lo = minJointAngle.data();
+        const float* hi = maxJointAngle.data();
+
+        for (size_t j = 0; j < n; j++) {
+            float wanted = angle[j] + deltaTime * dir[j];
+            float clamped = glm::min(glm::max(wanted, lo[j]), hi[j]);
+            dir[j] = (clamped != wanted) ? -dir[j] : dir[j];
+            angle[j] = clamped;
+        }
+    }
+
+    // pd servos: sets every joint's torque to pull it towards targetAngles (laid out like jointAngle) and
+    // damp its velocity
+    void servoTorques(const float* targetAngles, float stiffness, float damping) {
+        size_t n = size();
+        const float* angle = jointAngle.data();
+        const float* vel = jointVelocity.data();
+        float* torque = jointTorque.data();
+        for (size_t j = 0; j < n; j++) {
+            torque[j] = stiffness * (targetAngles[j] - angle[j]) - damping * vel[j];
+        }
+    }
+
+    // fills jointAcceleration from the current angles, velocities and torques
+    void updateAccelerations() {
+        for (int l = 0; l < legsPerRobot; l++) {
+            size_t first = jointIndex(0, l, 0);
+            legForwardDynamicsBatch(legDynamics[l], gravity, jointAngle.data() + first, jointVelocity.data() + first,
+                                    jointTorque.data() + first, jointAcceleration.data() + first, numRobots, numRobots);
+        }
+    }
+
+    // advances every joint by deltaTime under jointTorque and gravity, with the bodies held in place.
+    // accelerations come from the articulated body algorithm, one leg of every robot per batch, then
+    // semi-implicit euler. a joint that hits a limit stops dead there
+    void stepDynamics(float deltaTime) {
+        updateAccelerations();
+
+        size_t n = size();
+        float* angle = jointAngle.data();
+        float* vel = jointVelocity.data();
+        const float* acc = jointAcceleration.data();
+        const float* lo = minJointAngle.data();
+        const float* hi = maxJointAngle.data();
+        for (size_t j = 0; j < n; j++) {
+            float v = vel[j] + deltaTime * acc[j];
+            float wanted = angle[j] + deltaTime * v;
+            float clamped = glm::min(glm::max(wanted, lo[j]), hi[j]);
+            vel[j] = (clamped != wanted) ? 0.0f : v;
+            angle[j] = clamped;
+        }
+    }
+
+    // frames of every segment of one leg, for every robot. out needs room for
+    // legNumSegments[legIndex] * 12 * numRobots floats, laid out as described by legChainFKLanes
+    void legTransforms(int legIndex, float* out) const {
+        const float* angles = jointAngle.data() + jointIndex(0, legIndex, 0);
+        legChainFKBatch(legConstants[legIndex], angles, out, numRobots, numRobots);
+    }
+
+    // writes the joint angles of one robot back into a Robot, e.g. for rendering it
+    void copyTo(int robotIndex, Robot& out) const {
+        for (int s = 0; s < jointsPerRobot; s++) {
+            out.segments[s].jointAngle = jointAngle[(size_t)s * numRobots + robotIndex];
+        }
+        out.markAllDirty();
+    }
+};
+
+#endif /* RobotBatch.cpp */
@@ -0,0 +1,260 @@
+#ifndef _SELFCOLLISION_HPP
+#define _SELFCOLLISION_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "Robot.cpp"
+#include "SimdMath.hpp"
+
+// self collision between the boxes a robot is drawn as
+
+// an oriented box: center, unit axes and the half size along each
+struct obb {
+    glm::vec3 center;
+    glm::vec3 axis[3];
+    glm::vec3 halfExtent;
+};
+
+// the box of a shape: its transformation with the unit cube scaled by dimensions
+inline obb shapeBox(const glm::mat4& transformation, const glm::vec3& dimensions) {
+    obb b;
+    b.center = glm::vec3(transformation[3]);
+    for (int i = 0; i < 3; i++) {
+        b.axis[i] = glm::normalize(glm::vec3(transformation[i]));
+    }
+    b.halfExtent = 0.5f * dimensions;
+    return b;
+}
+
+// reference separating axis test using glm: the 3 face axes of each box and the 9 cross products of their
+// edges. boxes that just touch count as overlapping
+inline bool obbOverlap(const obb& a, const obb& b) {
+    const float epsilon = 1e-6f; // keeps near parallel edges from making a zero axis look separating
+    float R[3][3], absR[3][3], t[3];
+    glm::vec3 d = b.center - a.center;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            R[i][j] = glm::dot(a.axis[i], b.axis[j]);
+            absR[i][j] = glm::abs(R[i][j]) + epsilon;
+        }
+        t[i] = glm::dot(d, a.axis[i]);
+    }
+    const glm::vec3& ea = a.halfExtent;
+    const glm::vec3& eb = b.halfExtent;
+
+    for (int i = 0; i < 3; i++) {
+        float rb = eb[0] * absR[i][0] + eb[1] * absR[i][1] + eb[2] * absR[i][2];
+        if (glm::abs(t[i]) > ea[i] + rb) return false;
+    }
+    for (int j = 0; j < 3; j++) {
+        float ra = ea[0] * absR[0][j] + ea[1] * absR[1][j] + ea[2] * absR[2][j];
+        float tj = t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j];
+        if (glm::abs(tj) > ra + eb[j]) return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        for (int j = 0; j < 3; j++) {
+            int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+            float ra = ea[i1] * absR[i2][j] + ea[i2] * absR[i1][j];
+            float rb = eb[j1] * absR[i][j2] + eb[j2] * absR[i][j1];
+            if (glm::abs(t[i2] * R[i1][j] - t[i1] * R[i2][j]) > ra + rb) return false;
+        }
+    }
+    return true;
+}
+
+// floats per box in the batch layout: center, the three axes, half extents
+const int obbFloats = 15;
+
+// the separating axis test for a group of V::width box pairs, same as obbOverlap. box a of pair i is
+// boxes[f * stride + i] for f in [0, obbFloats), box b follows at f + obbFloats. overlap[i] is set to 1 if
+// the pair overlaps, 0 if not
+template <class V>
+inline void obbOverlapLanes(const float* boxes, int32_t* overlap, size_t i, size_t stride) {
+    typedef typename V::F F;
+    typedef typename V::I I;
+    F a[obbFloats], b[obbFloats];
+    for (int f = 0; f < obbFloats; f++) {
+        a[f] = V::load(boxes + f * stride + i);
+        b[f] = V::load(boxes + (obbFloats + f) * stride + i);
+    }
+    const F* ca = a;
+    const F* axesA = a + 3; // axis k at axesA[k * 3]
+    const F* ea = a + 12;
+    const F* cb = b;
+    const F* axesB = b + 3;
+    const F* eb = b + 12;
+
+    F R[3][3], absR[3][3], t[3];
+    F d[3] = {V::sub(cb[0], ca[0]), V::sub(cb[1], ca[1]), V::sub(cb[2], ca[2])};
+    const F epsilon = V::set1(1e-6f);
+    for (int i = 0; i < 3; i++) {
+        const F* ai = axesA + i * 3;
+        for (int j = 0; j < 3; j++) {
+            const F* bj = axesB + j * 3;
+            R[i][j] = V::madd(ai[2], bj[2], V::madd(ai[1], bj[1], V::mul(ai[0], bj[0])));
+            absR[i][j] = V::add(V::abs(R[i][j]), epsilon);
+        }
+        t[i] = V::madd(ai[2], d[2], V::madd(ai[1], d[1], V::mul(ai[0], d[0])));
+    }
+
+    // collect every separating axis rather than stopping early, there are no early outs across lanes
+    I separated = V::set1i(0);
+    for (int i = 0; i < 3; i++) {
+        F rb = V::madd(eb[2], absR[i][2], V::madd(eb[1], absR[i][1], V::mul(eb[0], absR[i][0])));
+        separated = V::ori(separated, V::less(V::add(ea[i], rb), V::abs(t[i])));
+    }
+    for (int j = 0; j < 3; j++) {
+        F ra = V::madd(ea[2], absR[2][j], V::madd(ea[1], absR[1][j], V::mul(ea[0], absR[0][j])));
+        F tj = V::madd(t[2], R[2][j], V::madd(t[1], R[1][j], V::mul(t[0], R[0][j])));
+        separated = V::ori(separated, V::less(V::add(ra, eb[j]), V::abs(tj)));
+    }
+    for (int i = 0; i < 3; i++) {
+        int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        for (int j = 0; j < 3; j++) {
+            int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+            F ra = V::madd(ea[i1], absR[i2][j], V::mul(ea[i2], absR[i1][j]));
+            F rb = V::madd(eb[j1], absR[i][j2], V::mul(eb[j2], absR[i][j1]));
+            F dist = V::sub(V::mul(t[i2], R[i1][j]), V::mul(t[i1], R[i2][j]));
+            separated = V::ori(separated, V::less(V::add(ra, rb), V::abs(dist)));
+        }
+    }
+    V::storei(overlap + i, V::andNot(separated, V::set1i(1)));
+}
+
+// overlap tests for count box pairs laid out as obbOverlapLanes describes, 8 (avx2) or 4 (sse) at a time
+inline void obbOverlapBatch(const float* boxes, int32_t* overlap, size_t count, size_t stride) {
+    size_t i = 0;
+#ifdef GLPLAY_SIMD_AVX
+    for (; i + 8 <= count; i += 8) obbOverlapLanes<simd::AvxLanes>(boxes, overlap, i, stride);
+#endif
+#ifdef GLPLAY_SIMD_SSE
+    for (; i + 4 <= count; i += 4) obbOverlapLanes<simd::SseLanes>(boxes, overlap, i, stride);
+#endif
+    for (; i < count; i++) obbOverlapLanes<simd::ScalarLanes>(boxes, overlap, i, stride);
+}
+
+// two parts of a robot that overlap: segment indices, -1 for the body
+struct collisionPair {
+    int a;
+    int b;
+};
+
+// finds which parts of a robot intersect each other, treating the body and every segment as the box it's
+// drawn as. pairs that always touch by construction are never tested: a segment and its parent, a leg's
+// first segment and the body, and parts of the same leg. everything else is a candidate, but legs are
+// pruned first with one bounding sphere each, then pairs with a sphere per box, and only the pairs left
+// go through the separating axis test, all of them in one batch
+class SelfCollision {
+public:
+    // pairs that survived the sphere tests in the last check, for seeing how much the pruning saves
+    int pairsTested = 0;
+
+    SelfCollision(const Robot& model) {
+        int numSegments = model.segments.size();
+        numLegs = model.legs.size();
+        boxes.resize(1 + numSegments);
+        legSpheres.resize(numLegs);
+
+        // the body against everything but the first segment of each leg
+        for (int j = 0; j < numSegments; j++) {
+            if (model.parentSegment[j] >= 0) {
+                candidates.push_back({-1, j});
+            }
+        }
+        // and every segment against every segment of the other legs
+        for (int j = 0; j < numSegments; j++) {
+            for (int k = j + 1; k < numSegments; k++) {
+                if (model.segmentLeg[j] != model.segmentLeg[k]) {
+                    candidates.push_back({j, k});
+                }
+            }
+        }
+        pairBoxes.resize((size_t)2 * obbFloats * candidates.size());
+        pairOverlap.resize(candidates.size());
+        tested.resize(candidates.size());
+    }
+
+    // checks the robot as posed (updateKinematics has to be up to date) and writes the overlapping pairs to
+    // out, replacing what was there. returns how many there are
+    int check(const Robot& robot, std::vector<collisionPair>& out) {
+        out.clear();
+
+        // boxes in the robot frame, and a sphere around each leg's boxes
+        boxes[0] = shapeBox(glm::mat4(1.0f), robot.bodyDimensions);
+        for (size_t j = 0; j < robot.segments.size(); j++) {
+            const Robot::legPart& part = robot.segments[j];
+            boxes[1 + j] = shapeBox(glm::translate(robot.getTransform(j), part.baseOffset), part.dimensions);
+        }
+        for (int l = 0; l < numLegs; l++) {
+            const Robot::leg& leg = robot.legs[l];
+            glm::vec3 lo(INFINITY), hi(-INFINITY);
+            for (int s = 0; s < leg.numSegments; s++) {
+                lo = glm::min(lo, boxes[1 + leg.firstSegment + s].center);
+                hi = glm::max(hi, boxes[1 + leg.firstSegment + s].center);
+            }
+            glm::vec3 center = 0.5f * (lo + hi);
+            float radius = 0.0f;
+            for (int s = 0; s < leg.numSegments; s++) {
+                const obb& b = boxes[1 + leg.firstSegment + s];
+                radius = glm::max(radius, glm::length(b.center - center) + glm::length(b.halfExtent));
+            }
+            legSpheres[l] = glm::vec4(center, radius);
+        }
+
+        // prune, and lay out whatever's left for the batch
+        size_t count = 0;
+        size_t stride = candidates.size();
+        for (const collisionPair& pair : candidates) {
+            const obb& a = boxes[1 + pair.a];
+            const obb& b = boxes[1 + pair.b];
+            if (pair.a >= 0 && !spheresTouch(legSpheres[robot.segmentLeg[pair.a]], legSpheres[robot.segmentLeg[pair.b]])) {
+                continue;
+            }
+            if (!spheresTouch(glm::vec4(a.center, glm::length(a.halfExtent)), glm::vec4(b.center, glm::length(b.halfExtent)))) {
+                continue;
+            }
+            writeBox(a, 0, count, stride);
+            writeBox(b, obbFloats, count, stride);
+            tested[count++] = pair;
+        }
+        pairsTested = count;
+
+        obbOverlapBatch(pairBoxes.data(), pairOverlap.data(), count, stride);
+        for (size_t i = 0; i < count; i++) {
+            if (pairOverlap[i]) out.push_back(tested[i]);
+        }
+        return out.size();
+    }
+
+private:
+    int numLegs;
+    std::vector<collisionPair> candidates;
+    std::vector<obb> boxes; // the body, then the segments
+    std::vector<glm::vec4> legSpheres; // center, radius
+    std::vector<float> pairBoxes; // the surviving pairs, laid out for obbOverlapBatch
+    std::vector<int32_t> pairOverlap;
+    std::vector<collisionPair> tested;
+
+    static bool spheresTouch(const glm::vec4& a, const glm::vec4& b) {
+        glm::vec3 d = glm::vec3(a) - glm::vec3(b);
+        float r = a.w + b.w;
+        return glm::dot(d, d) <= r * r;
+    }
+
+    void writeBox(const obb& box, int firstField, size_t i, size_t stride) {
+        float* out = pairBoxes.data() + (size_t)firstField * stride + i;
+        for (int c = 0; c < 3; c++) out[c * stride] = box.center[c];
+        for (int k = 0; k < 3; k++) {
+            for (int c = 0; c < 3; c++) out[(3 + k * 3 + c) * stride] = box.axis[k][c];
+        }
+        for (int c = 0; c < 3; c++) out[(12 + c) * stride] = box.halfExtent[c];
+    }
+};
+
+#endif /* SelfCollision.hpp */
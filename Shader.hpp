@@ -4,16 +4,68 @@
 #include <glad/glad.h> // include glad to get all the required OpenGL headers
 #include <glm/glm.hpp> // inlcude glm for glm::mat4 for the setMat4 function
 
+#include "UniformBlock.hpp"
+#include "GLState.hpp"
+
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// gl type enum for each c++ type a uniform can be set from
+template <class T> struct uniformGLType;
+template <> struct uniformGLType<float> { static const GLenum value = GL_FLOAT; };
+template <> struct uniformGLType<int> { static const GLenum value = GL_INT; };
+template <> struct uniformGLType<bool> { static const GLenum value = GL_BOOL; };
+template <> struct uniformGLType<glm::vec2> { static const GLenum value = GL_FLOAT_VEC2; };
+template <> struct uniformGLType<glm::vec3> { static const GLenum value = GL_FLOAT_VEC3; };
+template <> struct uniformGLType<glm::vec4> { static const GLenum value = GL_FLOAT_VEC4; };
+template <> struct uniformGLType<glm::mat2> { static const GLenum value = GL_FLOAT_MAT2; };
+template <> struct uniformGLType<glm::mat3> { static const GLenum value = GL_FLOAT_MAT3; };
+template <> struct uniformGLType<glm::mat4> { static const GLenum value = GL_FLOAT_MAT4; };
+
+// every sampler type glsl 330 has. they're all set with an int, the texture unit
+inline bool isSamplerType(GLenum type) {
+    switch (type) {
+    case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+    case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_SAMPLER_2D_ARRAY_SHADOW:
+    case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT: case GL_SAMPLER_2D_RECT_SHADOW:
+    case GL_INT_SAMPLER_1D: case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_CUBE:
+    case GL_INT_SAMPLER_1D_ARRAY: case GL_INT_SAMPLER_2D_ARRAY:
+    case GL_INT_SAMPLER_2D_MULTISAMPLE: case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_INT_SAMPLER_BUFFER: case GL_INT_SAMPLER_2D_RECT:
+    case GL_UNSIGNED_INT_SAMPLER_1D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_CUBE:
+    case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE: case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+        return true;
+    default:
+        return false;
+    }
+}
+
 class Shader
 {
 public:
     // the program ID
     unsigned int ID;
+
+    // an active uniform as reported by the program after linking
+    struct uniformInfo {
+        int location;
+        GLenum type;
+        int size; // array length, 1 for plain uniforms
+    };
+
+    // a uniform location resolved ahead of time, typed so it can only be set with the right kind of value.
+    // a handle to a uniform the program doesn't use has location -1, which gl quietly ignores
+    template <class T>
+    struct Uniform {
+        int location = -1;
+    };
   
     // constructor reads and builds the shader
     Shader(const char* vertexPath, const char* fragmentPath)
@@ -94,61 +146,152 @@ public:
         glDeleteShader(vertex);
         glDeleteShader(fragment);
 
+        reflectUniforms();
+        bindUniformBlocks();
     }
-    // use/activate the shader
+    // use/activate the shader. skipped if it's already in use
     void use() 
     { 
-        glUseProgram(ID);
+        GLState::useProgram(ID);
     }
-    // utility uniform functions
+    // the reflected uniform table, or NULL if the program has no active uniform by that name
+    const uniformInfo* findUniform(const std::string &name) const
+    {
+        auto it = uniforms.find(name);
+        return (it == uniforms.end()) ? NULL : &it->second;
+    }
+    int getLocation(const std::string &name) const
+    {
+        const uniformInfo* info = findUniform(name);
+        return info ? info->location : -1;
+    }
+    // look a uniform up once, up front, and keep the handle for the frame loop
+    template <class T>
+    Uniform<T> uniform(const std::string &name) const
+    {
+        Uniform<T> handle;
+        const uniformInfo* info = findUniform(name);
+        if (info == NULL) {
+            return handle; // not active, probably optimized out
+        }
+        // samplers are set with ints, and bools can be set with ints too
+        bool intLike = info->type == GL_BOOL || isSamplerType(info->type);
+        GLenum wanted = uniformGLType<T>::value;
+        if (info->type != wanted && !(wanted == GL_INT && intLike)) {
+            std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH " << name << std::endl;
+            return handle;
+        }
+        handle.location = info->location;
+        return handle;
+    }
+    // typed setters for pre resolved handles: no string, no lookup, straight to gl
+    void set(Uniform<bool> u, bool value) const { glUniform1i(u.location, (int)value); }
+    void set(Uniform<int> u, int value) const { glUniform1i(u.location, value); }
+    void set(Uniform<float> u, float value) const { glUniform1f(u.location, value); }
+    void set(Uniform<glm::vec2> u, const glm::vec2 &value) const { glUniform2fv(u.location, 1, &value[0]); }
+    void set(Uniform<glm::vec3> u, const glm::vec3 &value) const { glUniform3fv(u.location, 1, &value[0]); }
+    void set(Uniform<glm::vec4> u, const glm::vec4 &value) const { glUniform4fv(u.location, 1, &value[0]); }
+    void set(Uniform<glm::mat2> u, const glm::mat2 &mat) const { glUniformMatrix2fv(u.location, 1, GL_FALSE, &mat[0][0]); }
+    void set(Uniform<glm::mat3> u, const glm::mat3 &mat) const { glUniformMatrix3fv(u.location, 1, GL_FALSE, &mat[0][0]); }
+    void set(Uniform<glm::mat4> u, const glm::mat4 &mat) const { glUniformMatrix4fv(u.location, 1, GL_FALSE, &mat[0][0]); }
+    // utility uniform functions, by name. these go through the reflected table rather than the driver,
+    // but still hash the name every call, so prefer handles from uniform() in anything per frame
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(getLocation(name), (int)value); 
     }
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(getLocation(name), value); 
     }
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(getLocation(name), value); 
     }
     // find the location of the uniform and formats for us
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(getLocation(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(getLocation(name), x, y); 
     }
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(getLocation(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(getLocation(name), x, y, z); 
     }
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(getLocation(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(getLocation(name), x, y, z, w); 
     }
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+private:
+    std::unordered_map<std::string, uniformInfo> uniforms;
+
+    // asks the linked program for every active uniform once, so setting one never has to ask the driver
+    void reflectUniforms()
+    {
+        int count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(glm::max(maxLength, 1), '\0');
+        for (int i = 0; i < count; i++) {
+            int length = 0, size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, i, maxLength, &length, &size, &type, &name[0]);
+            std::string uniformName = name.substr(0, length);
+            int location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location < 0) {
+                continue; // in a uniform block, those are set through buffers
+            }
+            uniforms[uniformName] = {location, type, size};
+            // arrays are reported once, as "name[0]". make them findable by plain name too, and every element
+            // by its own "name[i]", with the size counting the elements from there to the end
+            if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+                std::string base = uniformName.substr(0, uniformName.size() - 3);
+                uniforms[base] = {location, type, size};
+                for (int element = 1; element < size; element++) {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    int elementLocation = glGetUniformLocation(ID, elementName.c_str());
+                    if (elementLocation >= 0) {
+                        uniforms[elementName] = {elementLocation, type, size - element};
+                    }
+                }
+            }
+        }
+    }
+
+    // points the program's shared uniform blocks (see UniformBlock.hpp) at their fixed binding points.
+    // glsl 330 can't say layout(binding = n) itself
+    void bindUniformBlocks()
+    {
+        for (const uniformBlockBinding& block : uniformBlockBindings) {
+            unsigned int index = glGetUniformBlockIndex(ID, block.name);
+            if (index != GL_INVALID_INDEX) {
+                glUniformBlockBinding(ID, index, block.binding);
+            }
+        }
     }
 };
 
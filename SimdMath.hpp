@@ -0,0 +1,270 @@
+#ifndef _SIMDMATH_HPP
+#define _SIMDMATH_HPP
+
+// thin wrappers that let the same kernel code run on 1, 4 or 8 floats at a time.
+// each "lanes" struct exposes the same set of static functions, and kernels are written as
+// templates over it, so the scalar version doubles as the reference for the vector ones.
+//
+// ScalarLanes is always available, SseLanes when compiled for SSE2 (any x86-64), and AvxLanes when
+// compiled with -mavx2 -mfma
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GLPLAY_SIMD_SSE 1
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define GLPLAY_SIMD_AVX 1
+#endif
+
+namespace simd {
+
+// constants for sincos. pi/2 is split into three parts (cody-waite) so the range reduction stays
+// accurate, and the polynomials are the cephes single precision ones for [-pi/4, pi/4]
+const float twoOverPi = 0.636619772367581343f;
+const float halfPiA = 1.5703125f;
+const float halfPiB = 4.837512969970703125e-4f;
+const float halfPiC = 7.54978995489188216e-8f;
+const float sinC0 = -1.9515295891e-4f;
+const float sinC1 = 8.3321608736e-3f;
+const float sinC2 = -1.6666654611e-1f;
+const float cosC0 = 2.443315711809948e-5f;
+const float cosC1 = -1.388731625493765e-3f;
+const float cosC2 = 4.166664568298827e-2f;
+
+// cephes atanf and asinf polynomials
+const float atanC0 = 8.05374449538e-2f;
+const float atanC1 = -1.38776856032e-1f;
+const float atanC2 = 1.99777106478e-1f;
+const float atanC3 = -3.33329491539e-1f;
+const float asinC0 = 4.2163199048e-2f;
+const float asinC1 = 2.4181311049e-2f;
+const float asinC2 = 4.5470025998e-2f;
+const float asinC3 = 7.4953002686e-2f;
+const float asinC4 = 1.6666752422e-1f;
+const float pi = 3.14159265358979323846f;
+const float tanEighthPi = 0.414213562373095f;
+
+struct ScalarLanes {
+    typedef float F;
+    typedef int32_t I;
+    static const int width = 1;
+
+    static F load(const float* p) { return *p; }
+    static void store(float* p, F a) { *p = a; }
+    static F set1(float a) { return a; }
+    static I set1i(int32_t a) { return a; }
+
+    static F add(F a, F b) { return a + b; }
+    static F sub(F a, F b) { return a - b; }
+    static F mul(F a, F b) { return a * b; }
+    static F madd(F a, F b, F c) { return a * b + c; } // a * b + c
+    static F div(F a, F b) { return a / b; }
+    static F sqrt(F a) { return sqrtf(a); }
+    static F min(F a, F b) { return a < b ? a : b; }
+    static F max(F a, F b) { return a > b ? a : b; }
+    static F abs(F a) { return fabsf(a); }
+
+    // comparisons give an all ones / all zeros integer mask per lane
+    static I less(F a, F b) { return a < b ? -1 : 0; }
+    static I lessEqual(F a, F b) { return a <= b ? -1 : 0; }
+    static I ori(I a, I b) { return a | b; }
+    static I andNot(I a, I b) { return ~a & b; } // (not a) and b
+    static I selecti(I mask, I a, I b) { return mask ? a : b; }
+    static bool any(I mask) { return mask != 0; }
+    static void storei(int32_t* p, I a) { *p = a; }
+
+    static I roundToInt(F a) { return (I)(a + copysignf(0.5f, a)); } // lrintf is a libm call, this inlines
+    static F toFloat(I a) { return (F)a; }
+    static I addi(I a, I b) { return a + b; }
+    static I andi(I a, I b) { return a & b; }
+    static I shiftLeft(I a, int bits) { return (I)((uint32_t)a << bits); }
+    static I equal(I a, I b) { return a == b ? -1 : 0; }
+
+    // flips the sign of a wherever bit 31 of signBits is set
+    static F xorSign(F a, I signBits) {
+        uint32_t bits;
+        memcpy(&bits, &a, sizeof(bits));
+        bits ^= (uint32_t)signBits & 0x80000000u;
+        memcpy(&a, &bits, sizeof(a));
+        return a;
+    }
+    // mask is all ones or all zeros per lane
+    static F select(I mask, F a, F b) { return mask ? a : b; }
+};
+
+#ifdef GLPLAY_SIMD_SSE
+struct SseLanes {
+    typedef __m128 F;
+    typedef __m128i I;
+    static const int width = 4;
+
+    static F load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, F a) { _mm_storeu_ps(p, a); }
+    static F set1(float a) { return _mm_set1_ps(a); }
+    static I set1i(int32_t a) { return _mm_set1_epi32(a); }
+
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F madd(F a, F b, F c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static F div(F a, F b) { return _mm_div_ps(a, b); }
+    static F sqrt(F a) { return _mm_sqrt_ps(a); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+    static F max(F a, F b) { return _mm_max_ps(a, b); }
+    static F abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+    static I less(F a, F b) { return _mm_castps_si128(_mm_cmplt_ps(a, b)); }
+    static I lessEqual(F a, F b) { return _mm_castps_si128(_mm_cmple_ps(a, b)); }
+    static I ori(I a, I b) { return _mm_or_si128(a, b); }
+    static I andNot(I a, I b) { return _mm_andnot_si128(a, b); }
+    static I selecti(I mask, I a, I b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+    static bool any(I mask) { return _mm_movemask_ps(_mm_castsi128_ps(mask)) != 0; }
+    static void storei(int32_t* p, I a) { _mm_storeu_si128((__m128i*)p, a); }
+
+    static I roundToInt(F a) { return _mm_cvtps_epi32(a); } // round to nearest in the default mode
+    static F toFloat(I a) { return _mm_cvtepi32_ps(a); }
+    static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+    static I andi(I a, I b) { return _mm_and_si128(a, b); }
+    static I shiftLeft(I a, int bits) { return _mm_slli_epi32(a, bits); }
+    static I equal(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+
+    static F xorSign(F a, I signBits) {
+        return _mm_xor_ps(a, _mm_and_ps(_mm_castsi128_ps(signBits), _mm_set1_ps(-0.0f)));
+    }
+    static F select(I mask, F a, F b) {
+        F m = _mm_castsi128_ps(mask);
+        return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+    }
+};
+#endif
+
+#ifdef GLPLAY_SIMD_AVX
+struct AvxLanes {
+    typedef __m256 F;
+    typedef __m256i I;
+    static const int width = 8;
+
+    static F load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, F a) { _mm256_storeu_ps(p, a); }
+    static F set1(float a) { return _mm256_set1_ps(a); }
+    static I set1i(int32_t a) { return _mm256_set1_epi32(a); }
+
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F madd(F a, F b, F c) { return _mm256_fmadd_ps(a, b, c); }
+    static F div(F a, F b) { return _mm256_div_ps(a, b); }
+    static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+    static I less(F a, F b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+    static I lessEqual(F a, F b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LE_OQ)); }
+    static I ori(I a, I b) { return _mm256_or_si256(a, b); }
+    static I andNot(I a, I b) { return _mm256_andnot_si256(a, b); }
+    static I selecti(I mask, I a, I b) { return _mm256_blendv_epi8(b, a, mask); }
+    static bool any(I mask) { return _mm256_movemask_ps(_mm256_castsi256_ps(mask)) != 0; }
+    static void storei(int32_t* p, I a) { _mm256_storeu_si256((__m256i*)p, a); }
+
+    static I roundToInt(F a) { return _mm256_cvtps_epi32(a); }
+    static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+    static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+    static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+    static I shiftLeft(I a, int bits) { return _mm256_slli_epi32(a, bits); }
+    static I equal(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+
+    static F xorSign(F a, I signBits) {
+        return _mm256_xor_ps(a, _mm256_and_ps(_mm256_castsi256_ps(signBits), _mm256_set1_ps(-0.0f)));
+    }
+    static F select(I mask, F a, F b) {
+        return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask));
+    }
+};
+#endif
+
+// sine and cosine of every lane at once. accurate to a couple of ulp for |x| up to a few thousand
+template <class V>
+inline void sincos(typename V::F x, typename V::F& sinOut, typename V::F& cosOut) {
+    typedef typename V::F F;
+    typedef typename V::I I;
+
+    // x = q * pi/2 + r, with r in [-pi/4, pi/4]
+    I q = V::roundToInt(V::mul(x, V::set1(twoOverPi)));
+    F qf = V::toFloat(q);
+    F r = V::madd(qf, V::set1(-halfPiA), x);
+    r = V::madd(qf, V::set1(-halfPiB), r);
+    r = V::madd(qf, V::set1(-halfPiC), r);
+
+    F r2 = V::mul(r, r);
+    F s = V::madd(V::madd(V::madd(V::set1(sinC0), r2, V::set1(sinC1)), r2, V::set1(sinC2)), V::mul(r2, r), r);
+    F c = V::madd(V::madd(V::madd(V::set1(cosC0), r2, V::set1(cosC1)), r2, V::set1(cosC2)), V::mul(r2, r2),
+                  V::madd(r2, V::set1(-0.5f), V::set1(1.0f)));
+
+    // odd quadrants swap sin and cos, and the sign follows bit 1 of q (q + 1 for cosine)
+    I one = V::set1i(1);
+    I two = V::set1i(2);
+    I swap = V::equal(V::andi(q, one), one);
+    F sinR = V::select(swap, c, s);
+    F cosR = V::select(swap, s, c);
+    sinOut = V::xorSign(sinR, V::shiftLeft(V::andi(q, two), 30));
+    cosOut = V::xorSign(cosR, V::shiftLeft(V::andi(V::addi(q, one), two), 30));
+}
+
+// atan2(y, x) for every lane, about 1e-7 radians off. atan2(0, 0) is 0
+template <class V>
+inline typename V::F atan2(typename V::F y, typename V::F x) {
+    typedef typename V::F F;
+    typedef typename V::I I;
+
+    F ax = V::abs(x);
+    F ay = V::abs(y);
+    F big = V::max(ax, ay);
+    F a = V::div(V::min(ax, ay), V::max(big, V::set1(1e-30f))); // in [0, 1]
+
+    // above tan(pi/8), use atan(a) = pi/4 + atan((a - 1) / (a + 1)) to keep the polynomial's input small
+    I reduce = V::less(V::set1(tanEighthPi), a);
+    F reduced = V::div(V::sub(a, V::set1(1.0f)), V::add(a, V::set1(1.0f)));
+    F t = V::select(reduce, reduced, a);
+    F offset = V::select(reduce, V::set1(0.25f * pi), V::set1(0.0f));
+
+    F z = V::mul(t, t);
+    F poly = V::madd(V::madd(V::madd(V::set1(atanC0), z, V::set1(atanC1)), z, V::set1(atanC2)), z, V::set1(atanC3));
+    F r = V::add(V::madd(V::mul(poly, z), t, t), offset);
+
+    // undo the octant folding
+    r = V::select(V::less(ax, ay), V::sub(V::set1(0.5f * pi), r), r);
+    r = V::select(V::less(x, V::set1(0.0f)), V::sub(V::set1(pi), r), r);
+    return V::xorSign(r, V::less(y, V::set1(0.0f)));
+}
+
+// acos(x) for every lane, x in [-1, 1]
+template <class V>
+inline typename V::F acos(typename V::F x) {
+    typedef typename V::F F;
+    typedef typename V::I I;
+
+    // asin(|x|), through asin(a) = pi/2 - 2 asin(sqrt((1 - a) / 2)) above 0.5
+    F a = V::abs(x);
+    I large = V::less(V::set1(0.5f), a);
+    F zLarge = V::mul(V::set1(0.5f), V::sub(V::set1(1.0f), a));
+    F t = V::select(large, V::sqrt(zLarge), a);
+    F z = V::select(large, zLarge, V::mul(a, a));
+
+    F poly = V::madd(V::madd(V::madd(V::madd(V::set1(asinC0), z, V::set1(asinC1)), z, V::set1(asinC2)), z, V::set1(asinC3)), z, V::set1(asinC4));
+    F s = V::madd(V::mul(poly, z), t, t);
+    s = V::select(large, V::madd(V::set1(-2.0f), s, V::set1(0.5f * pi)), s);
+
+    // acos(x) = pi/2 - asin(x), with asin odd
+    return V::sub(V::set1(0.5f * pi), V::xorSign(s, V::less(x, V::set1(0.0f))));
+}
+
+} // namespace simd
+
+#endif /* SimdMath.hpp */
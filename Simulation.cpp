@@ -1,5 +1,9 @@
+#ifndef _SIMULATION_CPP
+#define _SIMULATION_CPP
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 // for testing & printing purposes only
 #include "glm/gtx/string_cast.hpp"
@@ -10,67 +14,301 @@
 #include <iostream>
 
 #include "Robot.cpp"
+#include "Kinematics.hpp"
+#include "Gait.cpp"
+#include "Dynamics.hpp"
+#include "Contact.hpp"
 #include "Renderer.hpp"
 
+// every robot is a single rigid body standing on the ground. the legs follow the gait tables exactly, as
+// motion of the body's own shape, and the feet move the body only through their contacts with the ground:
+// a stance foot sweeping backwards drags on the ground and friction pushes the body forwards.
+// the body's mass properties are those of the whole robot in its starting pose, so a leg swinging doesn't
+// shift its center of mass or inertia. that's close enough with legs this light and cheap enough for a
+// field of robots
 class Simulation {
 private:
-    Robot myRobot;
+    // every robot is the same model walking the same gait, each starting on its own spot of a square grid
+    std::vector<Robot> robots;
+    std::vector<float> phaseOffsets; // so the field doesn't walk in lockstep
+
+    GaitTable gait;
+    float gaitPhase = 0.0f; // position in the gait cycle, [0, 1)
+    float gaitFrequency = 0.5f; // gait cycles per second
+
+    // the model's mass properties, in its body frame
+    float robotMass;
+    glm::vec3 centerOfMass;
+    glm::mat3 invInertia; // about the center of mass
+
+    // body state: center of mass in world space, orientation and velocities
+    std::vector<glm::vec3> bodyPosition;
+    std::vector<glm::quat> bodyOrientation;
+    BodyVelocities bodyVelocity;
+    std::vector<float> invMass; // per body, for the solver
 
-    int moveDir1 = 1;
-    int moveDir2 = 1;
+    // points of each robot that can touch the ground: the corners of every box it's drawn as, in the body
+    // frame. kept from the last step too, to tell how fast the legs move them
+    int pointsPerRobot;
+    float robotRadius; // furthest any of them gets from the center of mass
+    std::vector<glm::vec3> contactPoints; // [robot * pointsPerRobot + point]
+    std::vector<glm::vec3> pointScratch;
+
+    ContactSolver contacts;
 
 public:
-    Simulation() {
-        myRobot = Robot();
-    }
+    float robotSpacing = 18.0f; // distance between grid spots, a bit more than a hexapod's full span
 
-    void step(float deltaTime) {
-        // myRobot.legs[0].segments[0].jointAngle += deltaTime / 4;
+    glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+    // starts out flat, at the height the first robot's feet stand at in its starting pose
+    Heightfield ground;
 
-        if (!myRobot.setMotorAngle(0,1,myRobot.legs[0].segments[1].jointAngle + deltaTime * moveDir1)) {
-            moveDir1 *= -1;
+    Simulation(Gait_Type gaitType = GAIT_TRIPOD, int numRobots = 1) : Simulation(Robot(), gaitType, numRobots) {}
+
+    // a field of the given model. its legs have to be the 3 part kind GaitTable drives
+    Simulation(Robot model, Gait_Type gaitType, int numRobots) : gait(model, gaitType) {
+        // as square as possible, centered on the origin
+        int columns = (int)glm::ceil(glm::sqrt((float)glm::max(numRobots, 1)));
+        int rows = (numRobots + columns - 1) / columns;
+        robots.assign(numRobots, model);
+        std::vector<glm::vec3> spots;
+        for (int r = 0; r < numRobots; r++) {
+            float x = (r % columns - (columns - 1) * 0.5f) * robotSpacing;
+            float z = (r / columns - (rows - 1) * 0.5f) * robotSpacing;
+            spots.push_back(glm::vec3(x, 0.0f, z));
+            phaseOffsets.push_back(glm::fract(r * 0.618034f));
+        }
+        if (numRobots > 0) {
+            phaseOffsets[0] = 0.0f; // a lone robot starts at the start of its cycle
+        }
+
+        pointsPerRobot = 8 * (1 + model.segments.size());
+        contactPoints.resize((size_t)numRobots * pointsPerRobot);
+        pointScratch.resize(pointsPerRobot);
+
+        // mass properties from the first pose of the cycle
+        for (int i = 0; i < (int)model.legs.size(); i++) {
+            float angles[GaitTable::jointsPerLeg];
+            gait.sample(0.0f, i, angles);
+            for (int j = 0; j < GaitTable::jointsPerLeg; j++) model.setMotorAngle(i, j, angles[j]);
+        }
+        model.updateKinematics();
+        computeMassProperties(model);
+        robotRadius = glm::length(0.5f * model.bodyDimensions) + glm::length(centerOfMass);
+        for (const Robot::leg& l : model.legs) {
+            float reach = glm::length(l.baseOffset);
+            for (int s = 0; s < l.numSegments; s++) {
+                const Robot::legPart& part = model.segments[l.firstSegment + s];
+                reach += glm::length(part.connectOffset) + glm::length(0.5f * part.dimensions);
+            }
+            robotRadius = glm::max(robotRadius, reach + glm::length(centerOfMass));
         }
 
-        if (!myRobot.setMotorAngle(0,2,myRobot.legs[0].segments[2].jointAngle + deltaTime * moveDir2)) {
-            moveDir2 *= -1;
+        // everyone starts in their first pose, resting on the ground
+        float standingHeight = 0.0f;
+        for (int r = 0; r < numRobots; r++) {
+            poseRobot(r, glm::fract(gaitPhase + phaseOffsets[r]));
+            robots[r].updateKinematics();
+            writeContactPoints(robots[r], &contactPoints[(size_t)r * pointsPerRobot]);
+            float lowest = INFINITY;
+            for (int c = 0; c < pointsPerRobot; c++) lowest = glm::min(lowest, contactPoints[(size_t)r * pointsPerRobot + c].y);
+            if (r == 0) {
+                standingHeight = lowest;
+                ground = Heightfield(standingHeight);
+            }
+            spots[r].y = ground.height(spots[r].x, spots[r].z) - lowest;
+            bodyPosition.push_back(spots[r] + centerOfMass);
+            bodyOrientation.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
         }
+        bodyVelocity.resize(numRobots);
+        invMass.assign(numRobots, 1.0f / robotMass);
+        contacts = ContactSolver(numRobots, pointsPerRobot);
+    }
 
+    int robotCount() const {
+        return robots.size();
     }
 
-    std::vector<shape> getShapes() {
-        std::vector<shape> ret(/*1 + 6 * 3*/ 7); // one body shape, 6 legs, 3 shapes per leg
+    // contacts touching the ground in the last step, over all robots
+    int contactCount() const {
+        return contacts.totalContacts;
+    }
 
-        // for each leg
-        for (int i = 0; i < 1; i++) {
-            Robot::leg l = myRobot.legs[i];
-            int numSegments = 3;
-            glm::mat4 segmentMatrices[numSegments];
+    // where a robot's body frame is in the world
+    glm::mat4 bodyTransform(int r) const {
+        glm::mat4 m = glm::translate(glm::mat4(1.0f), bodyPosition[r]) * glm::mat4_cast(bodyOrientation[r]);
+        return glm::translate(m, -centerOfMass);
+    }
 
-            for (int j = 0; j < numSegments; j++) {
+    void step(float deltaTime) {
+        // contact velocities come from how far the legs moved the points over the step, which needs time to pass
+        if (deltaTime <= 0.0f) {
+            return;
+        }
+        gaitPhase = glm::fract(gaitPhase + deltaTime * gaitFrequency);
 
-                segmentMatrices[j] = glm::mat4(1.0f);
+        // every joint just follows the precomputed gait tables
+        for (size_t r = 0; r < robots.size(); r++) {
+            poseRobot(r, glm::fract(gaitPhase + phaseOffsets[r]));
+        }
 
+        // find what touches the ground
+        contacts.begin();
+        for (size_t r = 0; r < robots.size(); r++) {
+            Robot& robot = robots[r];
+            robot.updateKinematics();
+            bodyVelocity.setLinear(r, bodyVelocity.linear(r) + gravity * deltaTime);
 
-                if (j != 0) { // no offset for first part
-                    segmentMatrices[j] = segmentMatrices[j] * segmentMatrices[j - 1];
-                    segmentMatrices[j] = glm::translate(segmentMatrices[j],l.segments[j-1].connectOffset);
+            glm::mat3 rotation = glm::mat3_cast(bodyOrientation[r]);
+            glm::mat3 worldInvInertia = rotation * invInertia * glm::transpose(rotation);
+            glm::vec3* previous = &contactPoints[r * pointsPerRobot];
+            writeContactPoints(robot, pointScratch.data());
+            // how far the body could carry any of its points this step, the legs add their own motion
+            float bodyReach = deltaTime * (glm::length(bodyVelocity.linear(r)) + glm::length(bodyVelocity.angular(r)) * robotRadius);
+            for (int c = 0; c < pointsPerRobot; c++) {
+                glm::vec3 moved = pointScratch[c] - previous[c];
+                previous[c] = pointScratch[c];
+                glm::vec3 arm = rotation * (pointScratch[c] - centerOfMass);
+                glm::vec3 world = bodyPosition[r] + arm;
+                float depth = ground.height(world.x, world.z) - world.y;
+                float gap = -depth - bodyReach;
+                if (gap > 0.0f && glm::dot(moved, moved) < gap * gap) {
+                    continue; // can't get to the ground this step
                 }
+                contacts.addContact(r, c, arm, ground.normal(world.x, world.z), depth, rotation * moved / deltaTime,
+                                    invMass[r], worldInvInertia, deltaTime);
+            }
+        }
+        contacts.solve(bodyVelocity, invMass.data());
 
-                segmentMatrices[i] = glm::rotate(segmentMatrices[j],l.segments[j].jointAngle,l.segments[j].jointAxis);
+        for (size_t r = 0; r < robots.size(); r++) {
+            bodyPosition[r] += bodyVelocity.linear(r) * deltaTime;
+            glm::vec3 w = bodyVelocity.angular(r);
+            glm::quat& q = bodyOrientation[r];
+            q = glm::normalize(q + glm::quat(0.0f, w.x, w.y, w.z) * q * (0.5f * deltaTime));
+        }
+    }
 
+    // number of shapes writeShapes produces. fixed by the robots' topology, so callers can size their
+    // buffer once and reuse it every frame
+    int shapeCount() const {
+        int count = 0;
+        for (const Robot& robot : robots) {
+            count += 1 + robot.segments.size(); // the body, then one shape per segment
+        }
+        return count;
+    }
+
+    // fills out with the current shapes of every robot, without allocating.
+    // returns how many were written, which is shapeCount() unless capacity is smaller
+    int writeShapes(shape* out, int capacity) {
+        return forEachShape(capacity, [out](int i, const glm::mat4& transformation, const glm::vec3& dimensions, const glm::vec3& color) {
+            out[i].dimensions = dimensions;
+            out[i].transformation = transformation;
+            out[i].color = color;
+        });
+    }
 
-                shape newShape = {
-                    l.segments[j].dimensions,
-                    segmentMatrices[j] * glm::translate(glm::mat4(1.0f),l.segments[j].baseOffset),
-                    glm::vec3((float)j/2.0f,1.0f,1.0f)
-                };
-                ret.push_back(newShape);
+    // same as writeShapes, but straight into the instanced renderer's format. out can be gpu mapped memory
+    // (InstanceRenderer::beginInstances), so the shapes go to the gpu without any copy in between
+    int writeInstances(shapeInstance* out, int capacity) {
+        return forEachShape(capacity, [out](int i, const glm::mat4& transformation, const glm::vec3& dimensions, const glm::vec3& color) {
+            writeShapeInstance(out[i], transformation, dimensions, color);
+        });
+    }
+
+private:
+    void poseRobot(int r, float phase) {
+        Robot& robot = robots[r];
+        for (size_t i = 0; i < robot.legs.size(); i++) {
+            float angles[GaitTable::jointsPerLeg];
+            gait.sample(phase, i, angles);
+            for (int j = 0; j < GaitTable::jointsPerLeg; j++) {
+                robot.setMotorAngle(i, j, angles[j]);
             }
+        }
+    }
 
+    // the corners of the body box and then of every segment's box, in the body frame
+    static void writeContactPoints(const Robot& robot, glm::vec3* out) {
+        int n = 0;
+        for (int corner = 0; corner < 8; corner++) {
+            out[n++] = cornerSign(corner) * (0.5f * robot.bodyDimensions);
+        }
+        for (size_t j = 0; j < robot.segments.size(); j++) {
+            const Robot::legPart& part = robot.segments[j];
+            glm::mat4 box = glm::translate(robot.getTransform(j), part.baseOffset);
+            for (int corner = 0; corner < 8; corner++) {
+                out[n++] = glm::vec3(box * glm::vec4(cornerSign(corner) * (0.5f * part.dimensions), 1.0f));
+            }
         }
+    }
+
+    static glm::vec3 cornerSign(int corner) {
+        return glm::vec3((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+    }
 
+    // the whole robot's mass, center of mass and inverse inertia as posed, with every box solid
+    void computeMassProperties(const Robot& model) {
+        struct piece {
+            float mass;
+            glm::vec3 center;
+            glm::mat3 inertia; // about its own center, in the body frame
+        };
+        std::vector<piece> pieces;
 
+        glm::vec3 d = model.bodyDimensions;
+        float bodyMass = segmentDensity * d.x * d.y * d.z;
+        glm::mat3 bodyInertia(0.0f);
+        bodyInertia[0][0] = bodyMass / 12.0f * (d.y * d.y + d.z * d.z);
+        bodyInertia[1][1] = bodyMass / 12.0f * (d.x * d.x + d.z * d.z);
+        bodyInertia[2][2] = bodyMass / 12.0f * (d.x * d.x + d.y * d.y);
+        pieces.push_back({bodyMass, glm::vec3(0.0f), bodyInertia});
 
-        return ret;
+        for (size_t j = 0; j < model.segments.size(); j++) {
+            segmentInertia s = partInertia(model.segments[j]);
+            glm::mat3 aboutCenter = s.rotational - s.mass * (glm::dot(s.com, s.com) * glm::mat3(1.0f) - glm::outerProduct(s.com, s.com));
+            glm::mat3 rotation(model.getTransform(j));
+            glm::vec3 center = glm::vec3(model.getTransform(j) * glm::vec4(s.com, 1.0f));
+            pieces.push_back({s.mass, center, rotation * aboutCenter * glm::transpose(rotation)});
+        }
+
+        robotMass = 0.0f;
+        centerOfMass = glm::vec3(0.0f);
+        for (const piece& p : pieces) {
+            robotMass += p.mass;
+            centerOfMass += p.mass * p.center;
+        }
+        centerOfMass /= robotMass;
+
+        glm::mat3 inertia(0.0f);
+        for (const piece& p : pieces) {
+            glm::vec3 o = p.center - centerOfMass; // parallel axis theorem
+            inertia += p.inertia + p.mass * (glm::dot(o, o) * glm::mat3(1.0f) - glm::outerProduct(o, o));
+        }
+        invInertia = glm::inverse(inertia);
+    }
+
+    // calls write(index, transformation, dimensions, color) for each shape, up to capacity of them
+    template <class Writer>
+    int forEachShape(int capacity, Writer write) {
+        int written = 0;
+        for (size_t r = 0; r < robots.size() && written < capacity; r++) {
+            Robot& robot = robots[r];
+            robot.updateKinematics(); // only recomputes joints that moved since last time
+            glm::mat4 world = bodyTransform(r);
+
+            write(written++, world, robot.bodyDimensions, glm::vec3(0.8f, 0.8f, 0.8f));
+
+            int count = glm::min(capacity - written, (int)robot.segments.size());
+            for (int j = 0; j < count; j++) {
+                const Robot::legPart& part = robot.segments[j];
+                glm::mat4 transformation = world * glm::translate(robot.getTransform(j), part.baseOffset);
+                write(written++, transformation, part.dimensions, glm::vec3((float)robot.segmentDepth[j]/2.0f,1.0f,1.0f));
+            }
+        }
+        return written;
     }
-};
\ No newline at end of file
+};
+
+#endif /* Simulation.cpp */
\ No newline at end of file
@@ -0,0 +1,187 @@
+#ifndef _STATICROBOT_CPP
+#define _STATICROBOT_CPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <math.h>
+#include <utility>
+
+#include "Robot.cpp"
+#include "SimdMath.hpp"
+
+// portable force inline, for the recursion below that has to flatten into one body
+#if defined(_MSC_VER)
+#define GLPLAY_FORCE_INLINE __forceinline
+#elif defined(__GNUC__) || defined(__clang__)
+#define GLPLAY_FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define GLPLAY_FORCE_INLINE inline
+#endif
+
+// the hexapod with its shape fixed at compile time. joint axes, limits and offsets come from the same
+// standardLegParts table the Robot() constructor builds from, and every loop over legs and segments is
+// unrolled through templates, so joints about a coordinate axis become a handful of multiply-adds with no
+// zero terms.
+// it is a drop in for the runtime Robot in tight multi robot loops where the topology never changes
+template <int Legs, int Segs>
+class StaticRobot {
+public:
+    static_assert(Legs > 0, "a robot needs at least one leg");
+    static_assert(Segs > 0 && Segs <= 3, "part definitions only exist for the standard 3 part leg");
+
+    typedef standardLegPart part;
+
+    static constexpr float PI = standardPI;
+    static constexpr const part (&parts)[3] = standardLegParts;
+
+    // affine 3x4, column major: rotation in 0-8, translation in 9-11
+    struct frame {
+        float m[12];
+    };
+
+    float jointAngle[Legs][Segs];
+
+    // legs spread evenly around the body like Robot(Legs, bodyRadius)
+    StaticRobot(float bodyRadius = 2.0f) {
+        for (int l = 0; l < Legs; l++) {
+            float angle = 2.0f * PI * l / Legs;
+            float c = cosf(angle), s = sinf(angle);
+            // rotation about y, then the leg's position on the body
+            float base[12] = {c, 0, -s, 0, 1, 0, s, 0, c, bodyRadius * c, 0.0f, -bodyRadius * s};
+            for (int e = 0; e < 12; e++) legBase[l].m[e] = base[e];
+            for (int j = 0; j < Segs; j++) jointAngle[l][j] = 0.0f;
+        }
+        updateKinematics();
+    }
+
+    // compile time leg and motor, so there's no index math or table lookup at all
+    template <int L, int S>
+    bool setMotorAngle(float newAngle) {
+        static_assert(L >= 0 && L < Legs && S >= 0 && S < Segs, "no such joint");
+        float clamped = glm::clamp(newAngle, parts[S].minJointAngle, parts[S].maxJointAngle);
+        jointAngle[L][S] = clamped;
+        return clamped == newAngle;
+    }
+
+    // same as Robot::setMotorAngle
+    bool setMotorAngle(int legIndex, int motorIndex, float newAngle) {
+        float clamped = glm::clamp(newAngle, parts[motorIndex].minJointAngle, parts[motorIndex].maxJointAngle);
+        jointAngle[legIndex][motorIndex] = clamped;
+        return clamped == newAngle;
+    }
+
+    // sets every joint at once, unrolled. returns how many had to be clamped
+    int setMotorAngles(const float (&newAngles)[Legs][Segs]) {
+        return setLegAngles(newAngles, std::make_integer_sequence<int, Legs>());
+    }
+
+    // recomputes every segment frame. unlike Robot there is no dirty tracking: the whole update is a few
+    // dozen multiply-adds with no branches, which is cheaper than checking
+    void updateKinematics() {
+        updateLegs(std::make_integer_sequence<int, Legs>());
+    }
+
+    const frame& getSegmentFrame(int legIndex, int motorIndex) const {
+        return frames[legIndex][motorIndex];
+    }
+
+    glm::mat4 getSegmentTransform(int legIndex, int motorIndex) const {
+        const float* m = frames[legIndex][motorIndex].m;
+        glm::mat4 out(1.0f);
+        for (int col = 0; col < 4; col++) {
+            for (int row = 0; row < 3; row++) {
+                out[col][row] = m[col * 3 + row];
+            }
+        }
+        return out;
+    }
+
+private:
+    frame legBase[Legs];
+    frame frames[Legs][Segs];
+
+    template <int... L>
+    int setLegAngles(const float (&newAngles)[Legs][Segs], std::integer_sequence<int, L...>) {
+        return (setSegmentAngles<L>(newAngles[L], std::make_integer_sequence<int, Segs>()) + ...);
+    }
+
+    template <int L, int... S>
+    int setSegmentAngles(const float (&newAngles)[Segs], std::integer_sequence<int, S...>) {
+        return ((setMotorAngle<L, S>(newAngles[S]) ? 0 : 1) + ...);
+    }
+
+    template <int... L>
+    void updateLegs(std::integer_sequence<int, L...>) {
+        (updateSegment<L, 0>(legBase[L]), ...);
+    }
+
+    // which coordinate axis a part's joint turns about, or -1 if it isn't one
+    static constexpr int principalAxis(int S) {
+        const float* n = parts[S].jointAxis;
+        if (n[0] == 1 && n[1] == 0 && n[2] == 0) return 0;
+        if (n[0] == 0 && n[1] == 1 && n[2] == 0) return 1;
+        if (n[0] == 0 && n[1] == 0 && n[2] == 1) return 2;
+        return -1;
+    }
+
+    // frame[S] = parent * T(connectOffset[S - 1]) * R(angle[S], axis[S]), recursing down the leg.
+    // everything about the part is known here, so zero terms are dropped with if constexpr rather than
+    // left for the optimizer (which can't fold x * 0 without -ffast-math)
+    template <int L, int S>
+    GLPLAY_FORCE_INLINE void updateSegment(const frame& parent) {
+        if constexpr (S < Segs) {
+            const float* p = parent.m;
+            float* out = frames[L][S].m;
+
+            // translation: parent position plus the parent's rotation applied to the offset
+            float t[3] = {p[9], p[10], p[11]};
+            if constexpr (S > 0) {
+                constexpr float o0 = parts[S - 1].connectOffset[0];
+                constexpr float o1 = parts[S - 1].connectOffset[1];
+                constexpr float o2 = parts[S - 1].connectOffset[2];
+                for (int r = 0; r < 3; r++) {
+                    if constexpr (o0 != 0) t[r] += p[r] * o0;
+                    if constexpr (o1 != 0) t[r] += p[3 + r] * o1;
+                    if constexpr (o2 != 0) t[r] += p[6 + r] * o2;
+                }
+            }
+
+            float s, c;
+            simd::sincos<simd::ScalarLanes>(jointAngle[L][S], s, c); // inlines, unlike sinf/cosf
+
+            constexpr int a = principalAxis(S);
+            if constexpr (a >= 0) {
+                // turning about a coordinate axis keeps that column of the parent and mixes the other two
+                constexpr int u = (a + 1) % 3, v = (a + 2) % 3;
+                for (int r = 0; r < 3; r++) {
+                    float pu = p[u * 3 + r], pv = p[v * 3 + r];
+                    out[a * 3 + r] = p[a * 3 + r];
+                    out[u * 3 + r] = pu * c + pv * s;
+                    out[v * 3 + r] = pv * c - pu * s;
+                }
+            } else {
+                // any other axis: R = n n^T + cos (I - n n^T) + sin [n]x
+                constexpr float nx = parts[S].jointAxis[0], ny = parts[S].jointAxis[1], nz = parts[S].jointAxis[2];
+                float joint[9] = {
+                    nx * nx + c * (1 - nx * nx),  nx * ny * (1 - c) + s * nz,  nx * nz * (1 - c) - s * ny,
+                    nx * ny * (1 - c) - s * nz,   ny * ny + c * (1 - ny * ny), ny * nz * (1 - c) + s * nx,
+                    nx * nz * (1 - c) + s * ny,   ny * nz * (1 - c) - s * nx,  nz * nz + c * (1 - nz * nz)
+                };
+                for (int col = 0; col < 3; col++) {
+                    for (int r = 0; r < 3; r++) {
+                        out[col * 3 + r] = p[r] * joint[col * 3] + p[3 + r] * joint[col * 3 + 1] + p[6 + r] * joint[col * 3 + 2];
+                    }
+                }
+            }
+            for (int r = 0; r < 3; r++) out[9 + r] = t[r];
+
+            updateSegment<L, S + 1>(frames[L][S]);
+        }
+    }
+};
+
+// the standard hexapod
+typedef StaticRobot<6, 3> StaticHexapod;
+
+#endif /* StaticRobot.cpp */
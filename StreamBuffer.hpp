@@ -0,0 +1,154 @@
+#ifndef _STREAMBUFFER_HPP
+#define _STREAMBUFFER_HPP
+
+#include <glad/glad.h>
+
+#include <stddef.h>
+#include <string.h>
+
+// glBufferStorage is gl 4.4 / ARB_buffer_storage, newer than the 3.3 glad was generated for, so it's
+// loaded by hand in loadStreamBufferExtensions
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC_)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+inline PFNGLBUFFERSTORAGEPROC_ glBufferStorageFn = NULL; // one for the whole program, like the gl functions glad loads
+
+// call once after gladLoadGLLoader, with the same loader. returns true if persistent mapping is available
+inline bool loadStreamBufferExtensions(GLADloadproc load) {
+    glBufferStorageFn = NULL;
+    int major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    bool supported = major > 4 || (major == 4 && minor >= 4);
+    if (!supported) {
+        int numExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+        for (int i = 0; i < numExtensions && !supported; i++) {
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            supported = name && strcmp(name, "GL_ARB_buffer_storage") == 0;
+        }
+    }
+    if (supported) {
+        glBufferStorageFn = (PFNGLBUFFERSTORAGEPROC_)load("glBufferStorage");
+    }
+    return glBufferStorageFn != NULL;
+}
+
+// a buffer for data that's rewritten every frame, split into a ring of regions so the cpu can fill one
+// while the gpu is still drawing from the others. each region gets a fence when a draw using it is
+// submitted, and is only handed out again once that fence has passed.
+//
+// with buffer storage the whole buffer is mapped once, persistently and coherently, so writes go straight
+// into memory the gpu reads from, with no map calls or copies at all. without it (macos stops at gl 4.1)
+// each region is mapped unsynchronized when it's handed out, which the fences make safe
+class StreamBuffer {
+public:
+    static const int numRegions = 3;
+
+    unsigned int ID;
+
+    // how many times begin() had to wait for the gpu
+    long stalls = 0;
+
+    StreamBuffer(GLenum target, size_t regionSize) : target(target), regionSize(regionSize) {
+        glGenBuffers(1, &ID);
+        glBindBuffer(target, ID);
+        size_t totalSize = regionSize * numRegions;
+        if (glBufferStorageFn) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorageFn(target, totalSize, NULL, flags);
+            persistent = (char*)glMapBufferRange(target, 0, totalSize, flags);
+        }
+        if (!persistent) {
+            glBufferData(target, totalSize, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(target, 0);
+        for (int i = 0; i < numRegions; i++) fences[i] = NULL;
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // where to write the next region's data, at most regionSize bytes. waits if the gpu is still reading it
+    void* begin() {
+        waitForRegion(current);
+        if (persistent) {
+            return persistent + current * regionSize;
+        }
+        glBindBuffer(target, ID);
+        void* p = glMapBufferRange(target, current * regionSize, regionSize,
+                                   GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        glBindBuffer(target, 0);
+        return p;
+    }
+
+    // done writing. the region's data now starts at offset() in the buffer
+    void end() {
+        if (!persistent) {
+            glBindBuffer(target, ID);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+        }
+    }
+
+    // byte offset of the region last handed out by begin()
+    size_t offset() const {
+        return current * regionSize;
+    }
+
+    // call after submitting the draws that read the current region, then move on to the next one
+    void fence() {
+        if (fences[current]) {
+            glDeleteSync(fences[current]);
+        }
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        current = (current + 1) % numRegions;
+    }
+
+    bool isPersistent() const {
+        return persistent != NULL;
+    }
+
+    // frees the buffer and fences. call while the context still exists
+    void release() {
+        for (int i = 0; i < numRegions; i++) {
+            if (fences[i]) glDeleteSync(fences[i]);
+            fences[i] = NULL;
+        }
+        if (persistent) {
+            glBindBuffer(target, ID);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+            persistent = NULL;
+        }
+        glDeleteBuffers(1, &ID);
+        ID = 0;
+    }
+
+private:
+    GLenum target;
+    size_t regionSize;
+    int current = 0;
+    GLsync fences[numRegions];
+    char* persistent = NULL;
+
+    void waitForRegion(int region) {
+        if (!fences[region]) {
+            return;
+        }
+        GLenum result = glClientWaitSync(fences[region], 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            stalls++;
+            // flush so the fence is sure to get to the gpu, then wait as long as it takes
+            do {
+                result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fences[region]);
+        fences[region] = NULL;
+    }
+};
+
+#endif /* StreamBuffer.hpp */
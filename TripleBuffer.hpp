@@ -0,0 +1,56 @@
+#ifndef _TRIPLEBUFFER_HPP
+#define _TRIPLEBUFFER_HPP
+
+#include <atomic>
+
+// hands the latest value from one writer thread to one reader thread without either ever waiting.
+//
+// there are three slots: the writer owns one, the reader owns one, and the third sits in the middle holding
+// the most recently published value. publishing swaps the writer's slot with the middle one, reading swaps
+// the reader's slot with the middle one if something new was published since. both swaps are a single
+// atomic exchange, so a slow writer just means the reader sees the same value again, and a slow reader
+// just means values it never looked at get overwritten
+template <class T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle(1) {}
+
+    // the slot the writer fills. stays the writer's until the next publish
+    T& writeBuffer() {
+        return slots[back];
+    }
+
+    // makes the write buffer the latest value and hands the writer a free slot to fill next
+    void publish() {
+        back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // picks up the latest published value if there is one. returns true if it's new since the last call
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & freshBit) == 0) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    // the reader's current value. stays put until the next update
+    const T& readBuffer() const {
+        return slots[front];
+    }
+
+    T& readBuffer() {
+        return slots[front];
+    }
+
+private:
+    static const int indexMask = 3;
+    static const int freshBit = 4; // set on the middle index when it holds something the reader hasn't seen
+
+    T slots[3];
+    int back = 0; // writer's
+    int front = 2; // reader's
+    std::atomic<int> middle;
+};
+
+#endif /* TripleBuffer.hpp */
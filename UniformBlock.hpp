@@ -0,0 +1,99 @@
+#ifndef _UNIFORMBLOCK_HPP
+#define _UNIFORMBLOCK_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string.h>
+
+// state shared by every shader, kept in uniform buffers instead of per program uniforms. each block has a
+// fixed binding point, Shader hooks up any block with a matching name when it links, and the buffers are
+// bound to those points once. so one upload reaches every program, however many there are
+
+enum UBO_Binding {
+    UBO_FRAME = 0,
+    UBO_LIGHT = 1
+};
+
+// c++ mirrors of the std140 blocks in the shaders. std140 pads a vec3 out to 16 bytes, hence the vec4s
+// and padding. keep these in sync with shader.vs and shader.fs
+
+// uniform Frame
+struct frameBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float pad0;
+};
+static_assert(sizeof(frameBlock) == 144, "frameBlock must match the std140 layout of Frame");
+
+// uniform Light, holding a DirLight. vec3 members, each on its own 16 bytes
+struct lightBlock {
+    glm::vec3 direction;
+    float pad0;
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float pad3;
+};
+static_assert(sizeof(lightBlock) == 64, "lightBlock must match the std140 layout of Light");
+
+// block name in glsl -> binding point, for Shader to look up after linking
+struct uniformBlockBinding {
+    const char* name;
+    int binding;
+};
+const uniformBlockBinding uniformBlockBindings[] = {
+    {"Frame", UBO_FRAME},
+    {"Light", UBO_LIGHT}
+};
+
+// one uniform buffer holding a T. set() only touches the gpu when the contents actually changed
+template <class T>
+class UniformBlock {
+public:
+    UniformBlock(UBO_Binding binding) {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO); // stays bound, nothing else uses these points
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        memset(&data, 0, sizeof(T));
+    }
+
+    UniformBlock(const UniformBlock&) = delete;
+    UniformBlock& operator=(const UniformBlock&) = delete;
+
+    // returns true if it had to upload
+    bool set(const T& value) {
+        if (uploaded && memcmp(&value, &data, sizeof(T)) == 0) {
+            return false;
+        }
+        data = value;
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        uploaded = true;
+        return true;
+    }
+
+    const T& get() const {
+        return data;
+    }
+
+    // frees the buffer. call while the context still exists
+    void release() {
+        glDeleteBuffers(1, &UBO);
+        UBO = 0;
+        uploaded = false;
+    }
+
+private:
+    unsigned int UBO;
+    T data;
+    bool uploaded = false;
+};
+
+#endif /* UniformBlock.hpp */
@@ -0,0 +1,300 @@
+#ifndef _WORKSPACE_HPP
+#define _WORKSPACE_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Robot.cpp"
+#include "Kinematics.hpp"
+
+// where a leg's foot can go, precomputed as voxels so a footstep planner can throw away footholds without
+// solving IK for them
+
+// the foot workspace of one leg type, in the leg's own frame (before its base offset and rotation, so every
+// leg with the same parts shares one). built by stepping every joint through its limits finely enough that
+// the foot moves less than half a cell between neighbouring samples: every reachable point is then within
+// half a cell of a sampled foot position, so marking the cells around each sample's cell never misses one.
+// that makes a miss exact and a hit a maybe: the target is at most two cell diagonals from somewhere the foot
+// can go, and only IK can say more
+class ReachabilityMap {
+public:
+    glm::vec3 origin = glm::vec3(0.0f); // corner of cell (0, 0, 0)
+    float cellSize = 0.0f;
+    int size[3] = {0, 0, 0};
+
+    // poses sampled by the last build
+    long samples = 0;
+
+    // samples legIndex of robot with cells cellSize across
+    void build(const Robot& robot, int legIndex, float cellSize) {
+        this->cellSize = cellSize;
+        const Robot::leg& l = robot.legs[legIndex];
+        const Robot::legPart* parts = &robot.segments[l.firstSegment];
+
+        // the chain with no base transform, so frames come out in the leg's frame
+        LegChainConstants chain(robot, legIndex);
+        for (int e = 0; e < 12; e++) chain.base[e] = (e % 4 == 0 && e < 9) ? 1.0f : 0.0f;
+        int numSegments = chain.numSegments;
+
+        // a joint swinging by a can move the foot at most a times the length of the chain past it. split the
+        // half cell budget evenly between the joints, since each sample can be half a step off in every one
+        int steps[maxLegSegments];
+        float angleStep[maxLegSegments];
+        long total = 1;
+        for (int s = 0; s < numSegments; s++) {
+            float reach = 0.0f;
+            for (int k = s; k < numSegments; k++) reach += glm::length(parts[k].connectOffset);
+            float range = parts[s].maxJointAngle - parts[s].minJointAngle;
+            float maxStep = cellSize / (numSegments * glm::max(reach, 1e-6f));
+            steps[s] = (int)ceilf(range / maxStep) + 1;
+            angleStep[s] = (steps[s] > 1) ? range / (steps[s] - 1) : 0.0f;
+            total *= steps[s];
+        }
+        samples = total;
+
+        // the foot can't get further from the first joint than the whole chain is long. a cell of room on
+        // each side past that for the marking below
+        float chainLength = 0.0f;
+        for (int s = 0; s < numSegments; s++) chainLength += glm::length(parts[s].connectOffset);
+        origin = glm::vec3(-chainLength - cellSize);
+        for (int a = 0; a < 3; a++) {
+            size[a] = (int)ceilf(2.0f * chainLength / cellSize) + 3;
+        }
+        std::vector<uint64_t> hit(words(), 0);
+
+        // foot positions in batches through the fk kernel, the last joint varying fastest
+        const size_t batch = 4096;
+        std::vector<float> angles((size_t)numSegments * batch);
+        std::vector<float> frames((size_t)numSegments * 12 * batch);
+        const float* o = chain.connectOffset[numSegments - 1];
+        for (long first = 0; first < total; first += batch) {
+            size_t count = (size_t)glm::min((long)batch, total - first);
+            for (size_t i = 0; i < count; i++) {
+                long index = first + i;
+                for (int s = numSegments - 1; s >= 0; s--) {
+                    angles[s * batch + i] = parts[s].minJointAngle + (index % steps[s]) * angleStep[s];
+                    index /= steps[s];
+                }
+            }
+            legChainFKBatch(chain, angles.data(), frames.data(), count, batch);
+            const float* last = frames.data() + (size_t)(numSegments - 1) * 12 * batch;
+            for (size_t i = 0; i < count; i++) {
+                glm::vec3 foot;
+                for (int r = 0; r < 3; r++) {
+                    foot[r] = last[(9 + r) * batch + i] + last[r * batch + i] * o[0]
+                        + last[(3 + r) * batch + i] * o[1] + last[(6 + r) * batch + i] * o[2];
+                }
+                set(hit, cellIndex(foot));
+            }
+        }
+
+        // a cell is reachable if it or any of its neighbours was hit
+        reachable.assign(words(), 0);
+        for (int z = 1; z < size[2] - 1; z++) {
+            for (int y = 1; y < size[1] - 1; y++) {
+                for (int x = 1; x < size[0] - 1; x++) {
+                    bool any = false;
+                    for (int dz = -1; dz <= 1 && !any; dz++) {
+                        for (int dy = -1; dy <= 1 && !any; dy++) {
+                            for (int dx = -1; dx <= 1 && !any; dx++) {
+                                any = test(hit, index(x + dx, y + dy, z + dz));
+                            }
+                        }
+                    }
+                    if (any) set(reachable, index(x, y, z));
+                }
+            }
+        }
+    }
+
+    // false if no pose within the joint limits puts the foot at p, which is in the leg's frame
+    bool mayReach(glm::vec3 p) const {
+        glm::vec3 c = (p - origin) / cellSize;
+        if (c.x < 0.0f || c.y < 0.0f || c.z < 0.0f || c.x >= size[0] || c.y >= size[1] || c.z >= size[2]) {
+            return false;
+        }
+        return test(reachable, index((int)c.x, (int)c.y, (int)c.z));
+    }
+
+    // bytes the bitmap takes
+    size_t bytes() const {
+        return reachable.size() * sizeof(uint64_t);
+    }
+
+    void write(std::ostream& out) const {
+        out.write((const char*)&origin, sizeof(origin));
+        out.write((const char*)&cellSize, sizeof(cellSize));
+        out.write((const char*)size, sizeof(size));
+        out.write((const char*)reachable.data(), reachable.size() * sizeof(uint64_t));
+    }
+
+    bool read(std::istream& in) {
+        in.read((char*)&origin, sizeof(origin));
+        in.read((char*)&cellSize, sizeof(cellSize));
+        in.read((char*)size, sizeof(size));
+        if (!in || cellSize <= 0.0f || size[0] <= 0 || size[1] <= 0 || size[2] <= 0) return false;
+        reachable.assign(words(), 0);
+        in.read((char*)reachable.data(), reachable.size() * sizeof(uint64_t));
+        return (bool)in;
+    }
+
+private:
+    // a bit per cell, x fastest
+    std::vector<uint64_t> reachable;
+
+    size_t words() const {
+        return ((size_t)size[0] * size[1] * size[2] + 63) / 64;
+    }
+
+    size_t index(int x, int y, int z) const {
+        return (size_t)x + size[0] * ((size_t)y + (size_t)size[1] * z);
+    }
+
+    size_t cellIndex(glm::vec3 p) const {
+        glm::ivec3 c = glm::ivec3((p - origin) / cellSize);
+        return index(c.x, c.y, c.z);
+    }
+
+    static bool test(const std::vector<uint64_t>& bits, size_t i) {
+        return (bits[i >> 6] >> (i & 63)) & 1;
+    }
+
+    static void set(std::vector<uint64_t>& bits, size_t i) {
+        bits[i >> 6] |= (uint64_t)1 << (i & 63);
+    }
+};
+
+// the workspaces of all of a robot's legs. legs with the same parts share a map, so the standard hexapod
+// has one. lookups take targets in the robot frame, same as solveLegIK
+class LegWorkspace {
+public:
+    LegWorkspace(const Robot& robot) {
+        for (int l = 0; l < (int)robot.legs.size(); l++) {
+            const Robot::leg& leg = robot.legs[l];
+            glm::mat4 r = glm::rotate(glm::mat4(1.0f), -leg.baseRotationAngle, leg.baseRotationAxis);
+            toLeg.push_back(glm::mat3(r));
+            baseOffset.push_back(leg.baseOffset);
+
+            std::vector<float> signature = legSignature(robot, l);
+            int type = -1;
+            for (size_t t = 0; t < signatures.size(); t++) {
+                if (signatures[t] == signature) type = t;
+            }
+            if (type < 0) {
+                signatures.push_back(signature);
+                typeLeg.push_back(l);
+                type = signatures.size() - 1;
+            }
+            legType.push_back(type);
+        }
+        maps.resize(signatures.size());
+    }
+
+    // samples every leg type of the robot this was made for, see ReachabilityMap::build. slow, this is
+    // what the file is for
+    void build(const Robot& robot, float cellSize) {
+        for (size_t t = 0; t < maps.size(); t++) {
+            maps[t].build(robot, typeLeg[t], cellSize);
+        }
+    }
+
+    // see ReachabilityMap::mayReach. false means solveLegIK can't give IK_SOLVED for the target
+    bool mayReach(int legIndex, glm::vec3 target) const {
+        return maps[legType[legIndex]].mayReach(toLeg[legIndex] * (target - baseOffset[legIndex]));
+    }
+
+    int numTypes() const {
+        return maps.size();
+    }
+
+    const ReachabilityMap& map(int type) const {
+        return maps[type];
+    }
+
+    // each leg type's parts are saved next to its map, so a file built for different legs is refused
+    // instead of answering for the wrong ones
+    bool save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            std::cout << "ERROR::WORKSPACE::FILE_NOT_WRITABLE " << path << std::endl;
+            return false;
+        }
+        out.write(fileMagic, sizeof(fileMagic));
+        int32_t count = maps.size();
+        out.write((const char*)&count, sizeof(count));
+        for (size_t t = 0; t < maps.size(); t++) {
+            int32_t length = signatures[t].size();
+            out.write((const char*)&length, sizeof(length));
+            out.write((const char*)signatures[t].data(), length * sizeof(float));
+            maps[t].write(out);
+        }
+        return (bool)out;
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[sizeof(fileMagic)];
+        int32_t count = 0;
+        in.read(magic, sizeof(magic));
+        in.read((char*)&count, sizeof(count));
+        if (!in || memcmp(magic, fileMagic, sizeof(magic)) != 0) {
+            std::cout << "ERROR::WORKSPACE::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+            return false;
+        }
+        if (count != (int32_t)maps.size()) {
+            std::cout << "ERROR::WORKSPACE::WRONG_ROBOT " << path << std::endl;
+            return false;
+        }
+        std::vector<ReachabilityMap> loaded(count);
+        for (int t = 0; t < count; t++) {
+            int32_t length = 0;
+            in.read((char*)&length, sizeof(length));
+            std::vector<float> signature(glm::max(length, 0));
+            in.read((char*)signature.data(), signature.size() * sizeof(float));
+            if (!in || signature != signatures[t]) {
+                std::cout << "ERROR::WORKSPACE::WRONG_ROBOT " << path << std::endl;
+                return false;
+            }
+            if (!loaded[t].read(in)) {
+                std::cout << "ERROR::WORKSPACE::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+                return false;
+            }
+        }
+        maps.swap(loaded);
+        return true;
+    }
+
+private:
+    static constexpr char fileMagic[8] = {'g', 'l', 'P', 'r', 'e', 'a', 'c', 'h'};
+
+    std::vector<ReachabilityMap> maps; // per leg type
+    std::vector<std::vector<float>> signatures; // per leg type
+    std::vector<int> typeLeg; // per leg type, the first leg of it
+    std::vector<int> legType; // per leg
+    std::vector<glm::mat3> toLeg; // per leg, rotation from the robot frame into the leg frame
+    std::vector<glm::vec3> baseOffset; // per leg
+
+    // everything about a leg's parts that changes where its foot can go
+    static std::vector<float> legSignature(const Robot& robot, int legIndex) {
+        const Robot::leg& l = robot.legs[legIndex];
+        std::vector<float> signature;
+        for (int s = 0; s < l.numSegments; s++) {
+            const Robot::legPart& part = robot.segments[l.firstSegment + s];
+            for (int a = 0; a < 3; a++) signature.push_back(part.jointAxis[a]);
+            for (int a = 0; a < 3; a++) signature.push_back(part.connectOffset[a]);
+            signature.push_back(part.minJointAngle);
+            signature.push_back(part.maxJointAngle);
+        }
+        return signature;
+    }
+};
+
+#endif /* Workspace.hpp */
@@ -9,11 +9,23 @@
 
 #include <string>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <iostream>
 #include <math.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 #include "Renderer.hpp"
+#include "GeometryRegistry.hpp"
+#include "InstanceRenderer.hpp"
+#include "Culling.hpp"
+#include "RenderQueue.hpp"
 #include "Simulation.cpp"
+#include "TripleBuffer.hpp"
+#include "FixedStep.hpp"
 
 // declare these at the top so that code below can use them, but we can implement at bottom of code
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -26,7 +38,7 @@ const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
 // camera
-Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+Camera camera(glm::vec3(0.0f, 2.0f, 22.0f)); // far enough back to see the whole hexapod
 float mouseLastX = SCR_WIDTH / 2.0f;
 float mouseLastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
@@ -35,10 +47,36 @@ bool firstMouse = true;
 float deltaTime = 0.0f;	// Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 
-Simulation worldSim;
-
-int main()
+Simulation worldSim; // only touched by the simulation thread once it's running
+
+// the simulation runs on its own thread at a fixed rate, and hands its shapes over to rendering through a
+// triple buffer. neither side ever waits for the other: a slow frame doesn't slow the physics, and a slow
+// sim step just means the frame draws the previous snapshot again. each snapshot holds the last two states
+// the simulation stepped to, and frames draw somewhere between them, so a sim rate below the display's
+// still moves smoothly
+float simRate = 240.0f; // steps per second
+const int MAX_CATCH_UP_STEPS = 8; // most steps run at once after a hitch, any more time than that is dropped
+
+struct simSnapshot {
+    // already in the gpu's format, so rendering just blends them over
+    std::vector<shapeInstance> previous; // the state one step before current
+    std::vector<shapeInstance> current;
+    int numInstances = 0;
+    std::chrono::steady_clock::time_point time; // the moment current stands for
+};
+TripleBuffer<simSnapshot> snapshots;
+std::atomic<bool> simRunning(false);
+
+void runSimulation();
+
+int main(int argc, char** argv)
 {
+    // ./app [robots] [sim rate] walks a whole field of hexapods, one by default. a lower sim rate is
+    // cheaper, for slow machines
+    int numRobots = 1;
+    if (argc > 1) numRobots = glm::max(1, atoi(argv[1]));
+    if (argc > 2) simRate = glm::max(1.0f, (float)atof(argv[2]));
+
     // initialize and configure GLFW
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); // tell glfw that we're using opengl 3.3
@@ -71,6 +109,7 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    loadStreamBufferExtensions((GLADloadproc)glfwGetProcAddress); // persistent mapped buffers where there are any
 
     // configure global opengl state
     glEnable(GL_DEPTH_TEST);
@@ -78,74 +117,25 @@ int main()
     // build and compile our shader program
     Shader lightingShader("shaders/shader.vs", "shaders/shader.fs");
 
-    // set up vertex data and buffers and configure vertex attribute
-
-    float vertices[] = { // vertices for 36 points of 12 triangles of 6 faces of cube and normals
-        // positions          // normals
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-        0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-        0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-        0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-
-        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-        0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-        0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-        0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-
-        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-        -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-        -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-
-        0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-        0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-        0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-        0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-        0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-        0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-
-        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-        0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-        0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-        0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-
-        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-        0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-        0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-        0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
-    };
-
-
-    unsigned int VBO, cubeVAO; // create Vertex Buffer Object, Vertex Array Object
-    
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &VBO);
-
-    // copy vertex array into vertex buffer for OpenGl to use
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW); // copy data from vertices to buffer
-
-    glBindVertexArray(cubeVAO);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0); // position attribute
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float))); // normal attribute
-    glEnableVertexAttribArray(1);
- 
-
-    // set the vertex attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6  * sizeof(float), (void*)0); // we don't want to use the normals, but update the stride to match
-    glEnableVertexAttribArray(0);
+    // every mesh lives in one shared set of buffers. shapes are all boxes for now
+    GeometryRegistry geometry;
+    int boxMesh = geometry.addMesh(buildBoxMesh());
+    geometry.upload();
+
+    worldSim = Simulation(GAIT_TRIPOD, numRobots);
+
+    // per shape model matrices and colors, so all the shapes go out in one draw call
+    InstanceRenderer shapeRenderer(geometry, worldSim.shapeCount());
+
+    // bounds of every shape, to skip the ones outside the view before they're uploaded
+    ShapeBVH shapeBounds;
+
+    // the shapes as drawn this frame, blended between the snapshot's two states. this stays in ordinary
+    // memory rather than being blended straight into the mapped instance buffer: the bvh reads every shape to
+    // refit its bounds and culling reads them again to pick the visible ones, and mapped memory is write
+    // combined, slow to read back. only the cull's output, the visible shapes, is written into the mapping
+    std::vector<shapeInstance> frameInstances;
+    float lastBlend = -1.0f;
 
     // draw as wireframes rather than filled
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -155,57 +145,71 @@ int main()
     lightingShader.use();
     lightingShader.setInt("material.diffuse", 0);
     lightingShader.setInt("material.specular", 1);
-    lightingShader.setFloat("material.shininess", 32.0f);
 
-    worldSim = Simulation();
+    // draws are queued each frame and sorted by the state they need before going to gl
+    RenderQueue renderQueue;
+    int shapeMaterial = renderQueue.addMaterial({32.0f});
+
+    // camera and light live in uniform buffers shared by every shader, uploaded only when they change
+    UniformBlock<frameBlock> frameUniforms(UBO_FRAME);
+    UniformBlock<lightBlock> lightUniforms(UBO_LIGHT);
+
+    simRunning = true;
+    std::thread simThread(runSimulation);
 
     while (!glfwWindowShouldClose(window)) { // main render loop, terminates when glfw gets a close signal
         float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame; // useful for physics sim too
+        deltaTime = currentFrame - lastFrame; // camera movement is per second, the simulation keeps its own time
         lastFrame = currentFrame; 
 
         processInput(window); // call the process input function every frame
-        
-        worldSim.step(deltaTime);
-        std::vector<shape> renderShapes = worldSim.getShapes();
+
+        // whatever the simulation published last, drawn one step behind it: as time passes from the moment
+        // current stands for to a step after it, the shapes go from previous to current. by then the next
+        // snapshot should be in, and if it isn't they wait at current
+        bool freshSnapshot = snapshots.update();
+        const simSnapshot& latest = snapshots.readBuffer();
+        int numInstances = glm::min(latest.numInstances, shapeRenderer.capacity());
+        float blend = std::chrono::duration<float>(std::chrono::steady_clock::now() - latest.time).count() * simRate;
+        blend = glm::clamp(blend, 0.0f, 1.0f);
+        if (freshSnapshot || blend != lastBlend) {
+            frameInstances.resize(numInstances);
+            for (int i = 0; i < numInstances; i++) {
+                interpolateShapeInstance(frameInstances[i], latest.previous[i], latest.current[i], blend);
+            }
+            shapeBounds.update(frameInstances.data(), numInstances); // the shapes moved, so their bounds did too
+            lastBlend = blend;
+        }
 
         // render functions
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        lightingShader.use();
-
         glm::vec3 lightColor = glm::vec3(1.0f,1.0f,1.0f);
-        glm::vec3 ambientColor = lightColor * glm::vec3(0.2f); 
-        glm::vec3 diffuseColor = lightColor * glm::vec3(0.5f); 
-
-
-        lightingShader.setVec3("dirLight.ambient",ambientColor);
-        lightingShader.setVec3("dirLight.diffuse",diffuseColor);
-        lightingShader.setVec3("dirLight.specular",lightColor);
-        lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f); 
+        lightBlock light = {};
+        light.ambient = lightColor * glm::vec3(0.2f);
+        light.diffuse = lightColor * glm::vec3(0.5f);
+        light.specular = lightColor;
+        light.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+        lightUniforms.set(light); // never changes, so this only uploads on the first frame
 
         // view/projection transformations
-        lightingShader.setVec3("viewPos", camera.Position);
-        glm::mat4 projectionMat = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f); // 45 degree field of view, 800x600 aspect ratio, 0.1 close field, 100 far field
+        glm::mat4 projectionMat = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f); // 45 degree field of view, 800x600 aspect ratio, 0.1 close field, far enough for a big field of robots
         glm::mat4 viewMat = camera.GetViewMatrix();
-        lightingShader.setMat4("projection",projectionMat);
-        lightingShader.setMat4("view",viewMat);
-
-        glBindVertexArray(cubeVAO);
-
-        // render each shape of the robot
-        for (int i = 0; i < renderShapes.size(); i++) {
-            glm::mat4 modelMat = glm::mat4(1.0f);
-            modelMat *= renderShapes[i].transformation;
-            modelMat = glm::scale(modelMat,renderShapes[i].dimensions);
-
-            lightingShader.setMat4("model",modelMat);
-
-            lightingShader.setVec3("color",renderShapes[i].color); // make the light cube have the color of the light
-
-            glDrawArrays(GL_TRIANGLES,0,36);
-        }
+        frameBlock frame = {};
+        frame.projection = projectionMat;
+        frame.view = viewMat;
+        frame.viewPos = camera.Position;
+        frameUniforms.set(frame); // skipped while the camera sits still
+
+        // render every shape the camera can see at once. culling copies the visible ones into gpu visible memory,
+        // the only copy of the frame's instances that isn't on the cpu side
+        frustumPlanes frustum = extractFrustum(projectionMat * viewMat);
+        int numVisible = shapeBounds.cull(frustum, frameInstances.data(), shapeRenderer.beginInstances());
+        shapeRenderer.endInstances(numVisible);
+        renderQueue.add(lightingShader, boxMesh, shapeMaterial, 0.0f); // one batch for all of them, so depth doesn't matter
+        renderQueue.submit(shapeRenderer);
+        shapeRenderer.endFrame();
 
         // swap the buffers and poll IO event
         glfwSwapBuffers(window);
@@ -224,14 +228,50 @@ int main()
         glfwPollEvents();    
     }
 
+    simRunning = false;
+    simThread.join();
+
     // de-allocate all resources after they're done
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteBuffers(1, &VBO);
+    geometry.release();
+    shapeRenderer.release();
+    frameUniforms.release();
+    lightUniforms.release();
 
     glfwTerminate(); // clean up allocated glfw resources
     return 0;
 }
 
+void runSimulation() // the simulation thread: step as many times as real time says to, publish the shapes, sleep until the next step is due
+{
+    const float simDt = 1.0f / simRate;
+    FixedStep stepper(simDt, MAX_CATCH_UP_STEPS);
+    auto lastWake = std::chrono::steady_clock::now();
+
+    while (simRunning) {
+        auto now = std::chrono::steady_clock::now();
+        int steps = stepper.advance(std::chrono::duration<double>(now - lastWake).count());
+        lastWake = now;
+
+        if (steps > 0) {
+            simSnapshot& snapshot = snapshots.writeBuffer();
+            snapshot.previous.resize(worldSim.shapeCount()); // only allocates the first time each slot is used
+            snapshot.current.resize(worldSim.shapeCount());
+            for (int i = 0; i < steps; i++) {
+                if (i == steps - 1) { // the state before the last step is the one to blend from
+                    worldSim.writeInstances(snapshot.previous.data(), snapshot.previous.size());
+                }
+                worldSim.step(simDt);
+            }
+            snapshot.numInstances = worldSim.writeInstances(snapshot.current.data(), snapshot.current.size());
+            snapshot.time = now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(stepper.leftover()));
+            snapshots.publish();
+        }
+
+        auto untilNextStep = std::chrono::duration<double>(simDt - stepper.leftover());
+        std::this_thread::sleep_until(now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(untilNextStep));
+    }
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) // function that adjusts the opengl viewport whenever the user adjusts the window size
 {
     glViewport(0, 0, width, height);
@@ -14,15 +14,21 @@ struct DirLight {
     vec3 specular;
 };
 
-uniform DirLight dirLight;
+// shared by every program, see UniformBlock.hpp
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+layout (std140) uniform Light {
+    DirLight dirLight;
+};
 
 uniform Material material;
-uniform vec3 viewPos;
-
-uniform vec3 color;
 
 in vec3 Normal;
 in vec3 FragPos;
+in vec3 Color; // per instance, from the vertex shader
 
 out vec4 FragColor;
 
@@ -50,8 +56,8 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * color;
-    vec3 diffuse = light.diffuse * diff * color;
-    vec3 specular = light.specular * spec * color;
+    vec3 ambient = light.ambient * Color;
+    vec3 diffuse = light.diffuse * diff * Color;
+    vec3 specular = light.specular * spec * Color;
     return (ambient + diffuse + specular);
 }
\ No newline at end of file
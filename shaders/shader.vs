@@ -1,17 +1,25 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+layout (location = 2) in mat4 aModel; // per instance, takes locations 2-5
+layout (location = 6) in vec3 aColor; // per instance
+layout (location = 7) in mat3 aNormalMatrix; // per instance, takes locations 7-9. computed on the cpu
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per frame state shared by every program, see UniformBlock.hpp
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
 out vec3 Normal;
 out vec3 FragPos;
+out vec3 Color;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    FragPos = vec3(model * vec4(aPos, 1.0)); // multiply vertex coords by model matrix to get world coordinates
-    Normal = mat3(transpose(inverse(model))) * aNormal; // creatre the normal matrix via trickery. TODO: do this in the cpu and send it over, for efficiency
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+    FragPos = vec3(aModel * vec4(aPos, 1.0)); // multiply vertex coords by model matrix to get world coordinates
+    Normal = aNormalMatrix * aNormal;
+    Color = aColor;
 }
\ No newline at end of file
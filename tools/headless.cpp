@@ -0,0 +1,925 @@
+// headless simulation runner. steps the simulation at a fixed timestep as fast as the cpu allows,
+// with no window or opengl context, and reports how fast it went
+//
+// usage: headless [sim] [steps] [dt] [robots]
+//        headless fk [robots] [iterations]
+//        headless ik [targets] [iterations]
+//        headless static [robots] [iterations]
+//        headless triple [seconds]
+//        headless dynamics [robots] [seconds]
+//        headless contact [robots] [seconds]
+//        headless selfcollide [poses] [iterations]
+//        headless workspace [cell size] [file]
+//        headless fixedstep [robots] [seconds]
+//
+// sim: with robots > 0 it steps a RobotBatch of that many robots instead of the single robot Simulation
+// fk:  checks the batched forward kinematics kernel against the glm reference, then times both
+// ik:  checks the batched inverse kinematics solver against solveLegIK, then measures queries/sec for both
+// static: compares the compile time StaticHexapod against the runtime Robot for setting every joint and
+//         updating forward kinematics across many robots
+// triple: hammers the sim to render TripleBuffer from two threads and checks the reader never sees a torn
+//         or out of order snapshot
+// dynamics: checks the articulated body algorithm against inverse dynamics and a swinging leg's energy,
+//           then runs that many robots' legs under pd servos at 1 kHz for that much simulated time
+// contact: walks a field of robots on the ground at the app's 240 Hz and checks they stay standing and
+//          actually get somewhere
+// selfcollide: checks SelfCollision against testing every candidate pair with obbOverlap on random poses,
+//              checks the gaits never collide with themselves, then times a check per robot
+// workspace: builds the foot reachability maps, checks nothing they rule out is solvable by solveLegIK on
+//            random targets, and times a lookup against an IK solve. with a file it saves the maps there and
+//            checks they load back
+// fixedstep: checks FixedStep runs exactly floor(time / dt) steps for uneven frame times, with what's left
+//            over always under a step, that the simulation it drives ends up exactly where stepping it
+//            straight does, that the catch up guard drops time, and how far interpolated shapes stray from
+//            the real in between pose
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+#include "../Simulation.cpp"
+#include "../RobotBatch.cpp"
+#include "../Kinematics.hpp"
+#include "../Dynamics.hpp"
+#include "../StaticRobot.cpp"
+#include "../TripleBuffer.hpp"
+#include "../SelfCollision.hpp"
+#include "../Workspace.hpp"
+#include "../FixedStep.hpp"
+
+typedef std::chrono::steady_clock benchClock;
+
+static double secondsSince(benchClock::time_point start) {
+    return std::chrono::duration<double>(benchClock::now() - start).count();
+}
+
+static void printTiming(long numSteps, float dt, double seconds) {
+    double simSeconds = numSteps * (double)dt;
+    printf("steps:        %ld (dt = %g s, %g s simulated)\n", numSteps, dt, simSeconds);
+    printf("wall time:    %.4f s\n", seconds);
+    printf("steps/sec:    %.0f\n", numSteps / seconds);
+    printf("realtime x:   %.1f\n", simSeconds / seconds);
+}
+
+static int runBatch(long numSteps, float dt, int numRobots) {
+    RobotBatch batch(Robot(), numRobots);
+
+    auto start = benchClock::now();
+    for (long i = 0; i < numSteps; i++) {
+        batch.step(dt);
+    }
+    double seconds = secondsSince(start);
+
+    double checksum = 0.0;
+    for (size_t j = 0; j < batch.size(); j++) {
+        checksum += batch.jointAngle[j];
+    }
+
+    printf("robots:       %d (%d joints each)\n", numRobots, batch.jointsPerRobot);
+    printTiming(numSteps, dt, seconds);
+    printf("robot-steps/sec: %.0f\n", numSteps * (double)numRobots / seconds);
+    printf("checksum:     %.6f\n", checksum);
+    return 0;
+}
+
+static int runSim(int argc, char** argv) {
+    long numSteps = 100000;
+    float dt = 1.0f / 1000.0f; // 1 kHz default sim rate
+    int numRobots = 0;
+
+    if (argc > 0) numSteps = strtol(argv[0], NULL, 10);
+    if (argc > 1) dt = strtof(argv[1], NULL);
+    if (argc > 2) numRobots = atoi(argv[2]);
+    if (numSteps <= 0 || dt <= 0.0f || numRobots < 0) {
+        printf("usage: headless [sim] [steps] [dt] [robots]\n");
+        return 1;
+    }
+
+    if (numRobots > 0) {
+        return runBatch(numSteps, dt, numRobots);
+    }
+
+    Simulation worldSim;
+
+    auto start = benchClock::now();
+    for (long i = 0; i < numSteps; i++) {
+        worldSim.step(dt);
+    }
+    double seconds = secondsSince(start);
+
+    // checksum of the final pose, so runs can be compared and the loop can't be optimized away
+    std::vector<shape> finalShapes(worldSim.shapeCount());
+    int numShapes = worldSim.writeShapes(finalShapes.data(), finalShapes.size());
+    double checksum = 0.0;
+    for (int i = 0; i < numShapes; i++) {
+        for (int c = 0; c < 4; c++) {
+            checksum += finalShapes[i].transformation[3][c];
+        }
+    }
+
+    printTiming(numSteps, dt, seconds);
+    printf("checksum:     %.6f\n", checksum);
+    return 0;
+}
+
+static int runFK(int argc, char** argv) {
+    int numRobots = 4096;
+    int iterations = 200;
+    if (argc > 0) numRobots = atoi(argv[0]);
+    if (argc > 1) iterations = atoi(argv[1]);
+    if (numRobots <= 0 || iterations <= 0) {
+        printf("usage: headless fk [robots] [iterations]\n");
+        return 1;
+    }
+
+    Robot model;
+    RobotBatch batch(model, numRobots);
+
+    // random poses inside the joint limits
+    std::mt19937 rng(1234);
+    for (size_t j = 0; j < batch.size(); j++) {
+        std::uniform_real_distribution<float> dist(batch.minJointAngle[j], batch.maxJointAngle[j]);
+        batch.jointAngle[j] = dist(rng);
+    }
+
+    const int segs = maxLegSegments;
+    std::vector<float> frames((size_t)segs * 12 * numRobots);
+    std::vector<glm::mat4> reference((size_t)numRobots * segs);
+
+    // compare every frame of every leg against glm
+    float maxError = 0.0f;
+    for (int l = 0; l < batch.legsPerRobot; l++) {
+        batch.legTransforms(l, frames.data());
+        for (int r = 0; r < numRobots; r++) {
+            batch.copyTo(r, model);
+            glm::mat4 expected[maxLegSegments];
+            legSegmentTransforms(model, l, expected);
+            for (int s = 0; s < batch.legNumSegments[l]; s++) {
+                glm::mat4 got = legChainFrame(frames.data(), s, r, numRobots);
+                for (int col = 0; col < 4; col++) {
+                    for (int row = 0; row < 4; row++) {
+                        maxError = glm::max(maxError, glm::abs(got[col][row] - expected[s][col][row]));
+                    }
+                }
+            }
+        }
+    }
+
+    // translations are up to ~7 units long, so a few ulp at that magnitude
+    const float tolerance = 1e-5f;
+    printf("fk max abs error vs glm: %g (tolerance %g)\n", maxError, tolerance);
+
+    // timing: batch kernel against the glm reference on the same poses. each loop sums a bit of what it
+    // wrote, so neither can be optimized away
+    double checksum = 0.0;
+    auto start = benchClock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (int l = 0; l < batch.legsPerRobot; l++) {
+            batch.legTransforms(l, frames.data());
+            // the last robot's foot segment, x of its translation
+            checksum += frames[((size_t)(batch.legNumSegments[l] - 1) * 12 + 9) * numRobots + numRobots - 1];
+        }
+    }
+    double batchSeconds = secondsSince(start);
+
+    start = benchClock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (int r = 0; r < numRobots; r++) {
+            batch.copyTo(r, model);
+            for (int l = 0; l < batch.legsPerRobot; l++) {
+                legSegmentTransforms(model, l, &reference[(size_t)r * segs]);
+                checksum += reference[(size_t)r * segs + batch.legNumSegments[l] - 1][3][0];
+            }
+        }
+    }
+    double glmSeconds = secondsSince(start);
+
+    double legs = (double)iterations * numRobots * batch.legsPerRobot;
+    printf("batch kernel: %.1f M legs/sec\n", legs / batchSeconds / 1e6);
+    printf("glm:          %.1f M legs/sec\n", legs / glmSeconds / 1e6);
+    printf("checksum:     %.6f\n", checksum);
+
+    return maxError <= tolerance ? 0 : 1;
+}
+
+static int runIK(int argc, char** argv) {
+    int numTargets = 1 << 16;
+    int iterations = 50;
+    if (argc > 0) numTargets = atoi(argv[0]);
+    if (argc > 1) iterations = atoi(argv[1]);
+    if (numTargets <= 0 || iterations <= 0) {
+        printf("usage: headless ik [targets] [iterations]\n");
+        return 1;
+    }
+
+    Robot model;
+    Robot posed = model;
+    const int leg = 0;
+    const Robot::legPart* parts = &model.segments[model.legs[leg].firstSegment];
+    Robot::legPart* posedParts = &posed.segments[posed.legs[leg].firstSegment];
+    LegIKConstants constants(model, leg);
+
+    // half the targets are feet of random in-limit poses, the other half anywhere in a box around the leg,
+    // which is a mix of reachable, out of limits and out of reach
+    std::mt19937 rng(4321);
+    std::uniform_real_distribution<float> box(-9.0f, 9.0f);
+    std::vector<float> tx(numTargets), ty(numTargets), tz(numTargets);
+    for (int i = 0; i < numTargets; i++) {
+        glm::vec3 t;
+        if (i < numTargets / 2) {
+            for (int j = 0; j < 3; j++) {
+                std::uniform_real_distribution<float> dist(parts[j].minJointAngle, parts[j].maxJointAngle);
+                posedParts[j].jointAngle = dist(rng);
+            }
+            t = legFootPosition(posed, leg);
+        } else {
+            t = model.legs[leg].baseOffset + glm::vec3(box(rng), box(rng), box(rng));
+        }
+        tx[i] = t.x; ty[i] = t.y; tz[i] = t.z;
+    }
+
+    std::vector<float> angles((size_t)3 * numTargets, 0.0f);
+    std::vector<int32_t> status(numTargets);
+    size_t rejected = solveLegIKBatch(constants, tx.data(), ty.data(), tz.data(), angles.data(), status.data(), numTargets, numTargets);
+
+    // the batch solver should agree with the scalar one on every status, and put solved feet on target
+    int mismatches = 0;
+    int counts[3] = {0, 0, 0};
+    float maxFootError = 0.0f;
+    for (int i = 0; i < numTargets; i++) {
+        glm::vec3 t(tx[i], ty[i], tz[i]);
+        float expected[3];
+        IK_Result scalarResult = solveLegIK(model, leg, t, expected);
+        counts[status[i]]++;
+        if (scalarResult != status[i]) {
+            mismatches++;
+            continue;
+        }
+        if (status[i] == IK_SOLVED) {
+            for (int j = 0; j < 3; j++) {
+                posedParts[j].jointAngle = angles[(size_t)j * numTargets + i];
+            }
+            maxFootError = glm::max(maxFootError, glm::length(legFootPosition(posed, leg) - t));
+        }
+    }
+
+    const float tolerance = 1e-4f;
+    printf("targets:      %d solved, %d outside limits, %d out of reach (%zu rejected before trig)\n",
+           counts[IK_SOLVED], counts[IK_OUTSIDE_LIMITS], counts[IK_OUT_OF_REACH], rejected);
+    printf("status mismatches vs solveLegIK: %d\n", mismatches);
+    printf("max foot error: %g (tolerance %g)\n", maxFootError, tolerance);
+
+    auto start = benchClock::now();
+    for (int it = 0; it < iterations; it++) {
+        solveLegIKBatch(constants, tx.data(), ty.data(), tz.data(), angles.data(), status.data(), numTargets, numTargets);
+    }
+    double batchSeconds = secondsSince(start);
+
+    float sink = 0.0f;
+    start = benchClock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < numTargets; i++) {
+            float a[3] = {0.0f, 0.0f, 0.0f};
+            solveLegIK(model, leg, glm::vec3(tx[i], ty[i], tz[i]), a);
+            sink += a[1];
+        }
+    }
+    double scalarSeconds = secondsSince(start);
+
+    double queries = (double)iterations * numTargets;
+    printf("batch ik:     %.1f M queries/sec\n", queries / batchSeconds / 1e6);
+    printf("solveLegIK:   %.1f M queries/sec\n", queries / scalarSeconds / 1e6);
+    printf("checksum:     %.6f\n", sink + angles[1]);
+
+    // a handful of status flips right at a reach or limit boundary are float noise; more is a bug
+    bool ok = maxFootError <= tolerance && mismatches <= numTargets / 10000;
+    return ok ? 0 : 1;
+}
+
+static int runStatic(int argc, char** argv) {
+    int numRobots = 1000;
+    int iterations = 200;
+    if (argc > 0) numRobots = atoi(argv[0]);
+    if (argc > 1) iterations = atoi(argv[1]);
+    if (numRobots <= 0 || iterations <= 0) {
+        printf("usage: headless static [robots] [iterations]\n");
+        return 1;
+    }
+
+    const int legs = 6, segs = 3;
+    std::vector<Robot> robots(numRobots);
+    std::vector<StaticHexapod> staticRobots(numRobots);
+
+    // a different pose for every robot and iteration, so the dirty tracking in Robot always has work
+    float poses[2][legs][segs];
+    for (int p = 0; p < 2; p++) {
+        for (int l = 0; l < legs; l++) {
+            for (int j = 0; j < segs; j++) {
+                poses[p][l][j] = 0.3f * sinf(1.0f + p + l * 0.7f + j * 1.3f);
+            }
+        }
+    }
+
+    auto start = benchClock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (int r = 0; r < numRobots; r++) {
+            const float (&pose)[legs][segs] = poses[(it + r) & 1];
+            Robot& robot = robots[r];
+            for (int l = 0; l < legs; l++) {
+                for (int j = 0; j < segs; j++) {
+                    robot.setMotorAngle(l, j, pose[l][j]);
+                }
+            }
+            robot.updateKinematics();
+        }
+    }
+    double runtimeSeconds = secondsSince(start);
+
+    start = benchClock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (int r = 0; r < numRobots; r++) {
+            StaticHexapod& robot = staticRobots[r];
+            robot.setMotorAngles(poses[(it + r) & 1]);
+            robot.updateKinematics();
+        }
+    }
+    double staticSeconds = secondsSince(start);
+
+    // both should have ended on the same pose
+    float maxError = 0.0f;
+    for (int r = 0; r < numRobots; r++) {
+        for (int l = 0; l < legs; l++) {
+            for (int j = 0; j < segs; j++) {
+                glm::mat4 a = robots[r].getSegmentTransform(l, j);
+                glm::mat4 b = staticRobots[r].getSegmentTransform(l, j);
+                for (int col = 0; col < 4; col++) {
+                    for (int row = 0; row < 4; row++) {
+                        maxError = glm::max(maxError, glm::abs(a[col][row] - b[col][row]));
+                    }
+                }
+            }
+        }
+    }
+
+    const float tolerance = 1e-5f;
+    double robotUpdates = (double)iterations * numRobots;
+    printf("static vs runtime max abs error: %g (tolerance %g)\n", maxError, tolerance);
+    printf("Robot:         %.2f M robot updates/sec\n", robotUpdates / runtimeSeconds / 1e6);
+    printf("StaticHexapod: %.2f M robot updates/sec (%.1fx)\n", robotUpdates / staticSeconds / 1e6, runtimeSeconds / staticSeconds);
+    return maxError <= tolerance ? 0 : 1;
+}
+
+static int runTriple(int argc, char** argv) {
+    double duration = 1.0;
+    if (argc > 0) duration = atof(argv[0]);
+    if (duration <= 0.0) {
+        printf("usage: headless triple [seconds]\n");
+        return 1;
+    }
+
+    // every value in a snapshot is its sequence number, so a torn one has mixed values
+    struct snapshot {
+        long sequence = -1;
+        std::vector<long> values;
+    };
+    const int numValues = 4096;
+    TripleBuffer<snapshot> buffer;
+    std::atomic<bool> running(true);
+    long published = 0;
+
+    std::thread writer([&]() {
+        long sequence = 0;
+        while (running.load(std::memory_order_relaxed)) {
+            snapshot& s = buffer.writeBuffer();
+            s.values.resize(numValues);
+            for (int i = 0; i < numValues; i++) s.values[i] = sequence;
+            s.sequence = sequence++;
+            buffer.publish();
+        }
+        published = sequence;
+    });
+
+    long reads = 0, freshReads = 0, torn = 0, outOfOrder = 0, lastSequence = -1;
+    auto start = benchClock::now();
+    while (secondsSince(start) < duration) {
+        bool fresh = buffer.update();
+        const snapshot& s = buffer.readBuffer();
+        reads++;
+        if (!fresh) {
+            continue;
+        }
+        freshReads++;
+        if (s.sequence <= lastSequence) outOfOrder++;
+        lastSequence = s.sequence;
+        for (size_t i = 0; i < s.values.size(); i++) {
+            if (s.values[i] != s.sequence) {
+                torn++;
+                break;
+            }
+        }
+    }
+    running = false;
+    writer.join();
+
+    printf("published:    %ld snapshots\n", published);
+    printf("reads:        %ld (%ld fresh)\n", reads, freshReads);
+    printf("torn:         %ld\n", torn);
+    printf("out of order: %ld\n", outOfOrder);
+    return (torn == 0 && outOfOrder == 0) ? 0 : 1;
+}
+
+// kinetic plus potential energy of one leg, with the kinetic part from the mass matrix inverse dynamics
+// gives column by column and the potential part from the glm forward kinematics
+static double legEnergy(Robot& robot, int legIndex, const float* q, const float* qd, glm::vec3 gravity) {
+    const Robot::leg& l = robot.legs[legIndex];
+    int n = l.numSegments;
+    float zero[maxLegSegments] = {}, unit[maxLegSegments] = {}, column[maxLegSegments];
+
+    double kinetic = 0.0;
+    for (int j = 0; j < n; j++) {
+        unit[j] = 1.0f;
+        legInverseDynamics(robot, legIndex, q, zero, unit, glm::vec3(0.0f), column);
+        unit[j] = 0.0f;
+        for (int i = 0; i < n; i++) {
+            kinetic += 0.5 * qd[i] * column[i] * qd[j];
+        }
+    }
+
+    for (int s = 0; s < n; s++) {
+        robot.segments[l.firstSegment + s].jointAngle = q[s];
+    }
+    glm::mat4 frames[maxLegSegments];
+    legSegmentTransforms(robot, legIndex, frames);
+    double potential = 0.0;
+    for (int s = 0; s < n; s++) {
+        segmentInertia m = partInertia(robot.segments[l.firstSegment + s]);
+        glm::vec3 com = glm::vec3(frames[s] * glm::vec4(m.com, 1.0f));
+        potential -= m.mass * glm::dot(gravity, com);
+    }
+    return kinetic + potential;
+}
+
+static int runDynamics(int argc, char** argv) {
+    int numRobots = 500;
+    double duration = 1.0;
+    if (argc > 0) numRobots = atoi(argv[0]);
+    if (argc > 1) duration = atof(argv[1]);
+    if (numRobots <= 0 || duration <= 0.0) {
+        printf("usage: headless dynamics [robots] [seconds]\n");
+        return 1;
+    }
+
+    Robot model;
+    RobotBatch batch(model, numRobots);
+
+    // random states, then torques -> accelerations -> torques should come back where it started
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> speed(-3.0f, 3.0f), torque(-50.0f, 50.0f);
+    for (size_t j = 0; j < batch.size(); j++) {
+        std::uniform_real_distribution<float> angle(batch.minJointAngle[j], batch.maxJointAngle[j]);
+        batch.jointAngle[j] = angle(rng);
+        batch.jointVelocity[j] = speed(rng);
+        batch.jointTorque[j] = torque(rng);
+    }
+    batch.updateAccelerations();
+
+    float maxError = 0.0f;
+    for (int r = 0; r < numRobots; r++) {
+        for (int l = 0; l < batch.legsPerRobot; l++) {
+            float q[maxLegSegments], qd[maxLegSegments], qdd[maxLegSegments], tau[maxLegSegments];
+            for (int s = 0; s < batch.legNumSegments[l]; s++) {
+                size_t j = batch.jointIndex(r, l, s);
+                q[s] = batch.jointAngle[j];
+                qd[s] = batch.jointVelocity[j];
+                qdd[s] = batch.jointAcceleration[j];
+            }
+            legInverseDynamics(model, l, q, qd, qdd, batch.gravity, tau);
+            for (int s = 0; s < batch.legNumSegments[l]; s++) {
+                float expected = batch.jointTorque[batch.jointIndex(r, l, s)];
+                maxError = glm::max(maxError, glm::abs(tau[s] - expected) / glm::max(1.0f, glm::abs(expected)));
+            }
+        }
+    }
+    // float rounding, worst on small torques balancing big gravity and velocity terms. the worst case creeps
+    // up with the sample count: about 1.8e-4 at 500 robots and 3.2e-4 at 100000
+    const float tolerance = 5e-4f;
+    printf("aba vs inverse dynamics max rel error: %g (tolerance %g)\n", maxError, tolerance);
+
+    // a leg swinging freely from a sideways pose, with no limits or friction, should keep its energy
+    Robot swinging = model;
+    LegDynamicsConstants legConstants(model, 1);
+    float q[3] = {0.4f, 1.2f, -0.5f}, qd[3] = {0.0f, 0.0f, 0.0f}, tau[3] = {0.0f, 0.0f, 0.0f}, qdd[3];
+    const float swingDt = 1e-4f;
+    double startEnergy = legEnergy(swinging, 1, q, qd, batch.gravity);
+    double maxDrift = 0.0, energyScale = 0.0;
+    for (int step = 0; step < 20000; step++) {
+        legForwardDynamicsBatch(legConstants, batch.gravity, q, qd, tau, qdd, 1, 1);
+        for (int s = 0; s < 3; s++) {
+            qd[s] += swingDt * qdd[s];
+            q[s] += swingDt * qd[s];
+        }
+        if (step % 100 == 0) {
+            double energy = legEnergy(swinging, 1, q, qd, batch.gravity);
+            maxDrift = glm::max(maxDrift, glm::abs(energy - startEnergy));
+            energyScale = glm::max(energyScale, glm::abs(energy - legEnergy(swinging, 1, q, tau, batch.gravity))); // kinetic
+        }
+    }
+    double relativeDrift = maxDrift / glm::max(energyScale, 1e-9);
+    const double driftTolerance = 0.01;
+    printf("free swing energy drift: %g of peak kinetic energy %g (tolerance %g)\n", relativeDrift, energyScale, driftTolerance);
+
+    // timing: every robot's legs servoing towards a pose at 1 kHz
+    const float dt = 1.0f / 1000.0f;
+    long numSteps = lround(duration / dt);
+    std::vector<float> targets(batch.size());
+    for (size_t j = 0; j < batch.size(); j++) {
+        targets[j] = 0.5f * (batch.minJointAngle[j] + batch.maxJointAngle[j]);
+    }
+    auto start = benchClock::now();
+    for (long i = 0; i < numSteps; i++) {
+        batch.servoTorques(targets.data(), 400.0f, 20.0f);
+        batch.stepDynamics(dt);
+    }
+    double seconds = secondsSince(start);
+
+    double checksum = 0.0;
+    for (size_t j = 0; j < batch.size(); j++) {
+        checksum += batch.jointAngle[j];
+    }
+    printf("robots:       %d (%d legs, %d joints each)\n", numRobots, batch.legsPerRobot, batch.jointsPerRobot);
+    printTiming(numSteps, dt, seconds);
+    printf("legs/sec:     %.2f M\n", (double)numSteps * numRobots * batch.legsPerRobot / seconds / 1e6);
+    printf("checksum:     %.6f\n", checksum);
+
+    return (maxError <= tolerance && relativeDrift <= driftTolerance && checksum == checksum) ? 0 : 1;
+}
+
+static int runContact(int argc, char** argv) {
+    int numRobots = 100;
+    double duration = 10.0;
+    if (argc > 0) numRobots = atoi(argv[0]);
+    if (argc > 1) duration = atof(argv[1]);
+    if (numRobots <= 0 || duration <= 0.0) {
+        printf("usage: headless contact [robots] [seconds]\n");
+        return 1;
+    }
+
+    Simulation worldSim(GAIT_TRIPOD, numRobots);
+    std::vector<glm::vec3> start(numRobots);
+    for (int r = 0; r < numRobots; r++) {
+        start[r] = glm::vec3(worldSim.bodyTransform(r)[3]);
+    }
+
+    const float dt = 1.0f / 240.0f;
+    long numSteps = lround(duration / dt);
+    long contacts = 0;
+    auto startTime = benchClock::now();
+    for (long i = 0; i < numSteps; i++) {
+        worldSim.step(dt);
+        contacts += worldSim.contactCount();
+    }
+    double seconds = secondsSince(startTime);
+
+    // standing: still upright and at the height it started at. walking: moved along the gait's direction
+    float maxTilt = 0.0f, maxSink = 0.0f, minForward = INFINITY, maxSideways = 0.0f;
+    for (int r = 0; r < numRobots; r++) {
+        glm::mat4 body = worldSim.bodyTransform(r);
+        glm::vec3 moved = glm::vec3(body[3]) - start[r];
+        maxTilt = glm::max(maxTilt, glm::degrees(acosf(glm::clamp(glm::normalize(glm::vec3(body[1])).y, -1.0f, 1.0f))));
+        maxSink = glm::max(maxSink, glm::abs(moved.y));
+        minForward = glm::min(minForward, moved.x);
+        maxSideways = glm::max(maxSideways, glm::abs(moved.z));
+    }
+
+    printf("robots:       %d\n", numRobots);
+    printTiming(numSteps, dt, seconds);
+    printf("contacts:     %.1f per robot per step\n", (double)contacts / numSteps / numRobots);
+    printf("walked:       at least %.3f forward, at most %.3f sideways\n", minForward, maxSideways);
+    printf("max tilt:     %.3f degrees\n", maxTilt);
+    printf("max height change: %.3f\n", maxSink);
+
+    // with a stance foot always sweeping 0.5 per second, perfect traction would be 0.5 per second.
+    // feet slip some, but at least half of that should get through
+    float expectedForward = 0.5f * 0.5f * duration;
+    return (maxTilt < 5.0f && maxSink < 0.1f && minForward > expectedForward) ? 0 : 1;
+}
+
+static int runSelfCollide(int argc, char** argv) {
+    int numPoses = 10000;
+    int iterations = 20;
+    if (argc > 0) numPoses = atoi(argv[0]);
+    if (argc > 1) iterations = atoi(argv[1]);
+    if (numPoses <= 0 || iterations <= 0) {
+        printf("usage: headless selfcollide [poses] [iterations]\n");
+        return 1;
+    }
+
+    Robot model;
+    SelfCollision collision(model);
+    int numSegments = model.segments.size();
+
+    // random poses inside the joint limits, which sweep neighbouring legs into each other plenty
+    std::mt19937 rng(1234);
+    std::vector<float> poses((size_t)numPoses * numSegments);
+    for (int p = 0; p < numPoses; p++) {
+        for (int j = 0; j < numSegments; j++) {
+            std::uniform_real_distribution<float> dist(model.segments[j].minJointAngle, model.segments[j].maxJointAngle);
+            poses[(size_t)p * numSegments + j] = dist(rng);
+        }
+    }
+    auto setPose = [&](int p) {
+        for (int j = 0; j < numSegments; j++) model.setJointAngle(j, poses[(size_t)p * numSegments + j]);
+        model.updateKinematics();
+    };
+
+    // every pair the checker could report, tested with no pruning
+    std::vector<collisionPair> all;
+    for (int j = 0; j < numSegments; j++) {
+        if (model.parentSegment[j] >= 0) all.push_back({-1, j});
+    }
+    for (int j = 0; j < numSegments; j++) {
+        for (int k = j + 1; k < numSegments; k++) {
+            if (model.segmentLeg[j] != model.segmentLeg[k]) all.push_back({j, k});
+        }
+    }
+
+    std::vector<collisionPair> found;
+    long mismatches = 0, colliding = 0, pairsFound = 0, pairsTested = 0;
+    for (int p = 0; p < numPoses; p++) {
+        setPose(p);
+        collision.check(model, found);
+        pairsTested += collision.pairsTested;
+
+        std::vector<obb> boxes(1 + numSegments);
+        boxes[0] = shapeBox(glm::mat4(1.0f), model.bodyDimensions);
+        for (int j = 0; j < numSegments; j++) {
+            boxes[1 + j] = shapeBox(glm::translate(model.getTransform(j), model.segments[j].baseOffset), model.segments[j].dimensions);
+        }
+        size_t next = 0, expectedCount = 0;
+        for (const collisionPair& pair : all) {
+            if (!obbOverlap(boxes[1 + pair.a], boxes[1 + pair.b])) continue;
+            expectedCount++;
+            // both list pairs in candidate order
+            if (next < found.size() && found[next].a == pair.a && found[next].b == pair.b) next++;
+            else mismatches++;
+        }
+        if (expectedCount != found.size()) mismatches++;
+        colliding += found.empty() ? 0 : 1;
+        pairsFound += found.size();
+    }
+    printf("random poses: %d, %ld collide, %.2f colliding pairs each\n", numPoses, colliding, (double)pairsFound / numPoses);
+    printf("pairs past the spheres: %.1f of %zu candidates\n", (double)pairsTested / numPoses, all.size());
+    printf("mismatches vs unpruned obbOverlap: %ld\n", mismatches);
+
+    // walking shouldn't make a robot run into itself
+    long gaitCollisions = 0;
+    const Gait_Type gaits[3] = {GAIT_TRIPOD, GAIT_WAVE, GAIT_RIPPLE};
+    for (Gait_Type type : gaits) {
+        GaitTable gait(model, type);
+        for (int k = 0; k < GaitTable::samplesPerCycle; k++) {
+            for (int l = 0; l < (int)model.legs.size(); l++) {
+                float angles[GaitTable::jointsPerLeg];
+                gait.sample((float)k / GaitTable::samplesPerCycle, l, angles);
+                for (int j = 0; j < GaitTable::jointsPerLeg; j++) model.setMotorAngle(l, j, angles[j]);
+            }
+            model.updateKinematics();
+            gaitCollisions += collision.check(model, found);
+        }
+    }
+    printf("colliding pairs over every gait cycle: %ld\n", gaitCollisions);
+
+    // timing: the check alone, poses are set up front
+    std::vector<Robot> posed(numPoses < 1000 ? numPoses : 1000, model);
+    for (size_t p = 0; p < posed.size(); p++) {
+        for (int j = 0; j < numSegments; j++) posed[p].setJointAngle(j, poses[p * numSegments + j]);
+        posed[p].updateKinematics();
+    }
+    long checksum = 0;
+    auto start = benchClock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (const Robot& robot : posed) checksum += collision.check(robot, found);
+    }
+    double seconds = secondsSince(start);
+    printf("check: %.2f us per robot (checksum %ld)\n", seconds * 1e6 / ((double)iterations * posed.size()), checksum);
+
+    return (mismatches == 0 && gaitCollisions == 0) ? 0 : 1;
+}
+
+static int runWorkspace(int argc, char** argv) {
+    float cellSize = 0.25f;
+    const char* path = nullptr;
+    if (argc > 0) cellSize = atof(argv[0]);
+    if (argc > 1) path = argv[1];
+    if (cellSize <= 0.0f) {
+        printf("usage: headless workspace [cell size] [file]\n");
+        return 1;
+    }
+
+    Robot model;
+    LegWorkspace workspace(model);
+    auto start = benchClock::now();
+    workspace.build(model, cellSize);
+    double buildSeconds = secondsSince(start);
+    for (int t = 0; t < workspace.numTypes(); t++) {
+        const ReachabilityMap& map = workspace.map(t);
+        printf("leg type %d: %dx%dx%d cells, %zu bytes, %ld poses sampled\n", t, map.size[0], map.size[1], map.size[2],
+            map.bytes(), map.samples);
+    }
+    printf("built in %.2f s\n", buildSeconds);
+
+    // random targets around every leg. a target the map rules out must never be solvable
+    const int numTargets = 200000;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    std::vector<glm::vec3> targets(numTargets);
+    std::vector<int> targetLeg(numTargets);
+    for (int i = 0; i < numTargets; i++) {
+        targetLeg[i] = i % model.legs.size();
+        targets[i] = model.legs[targetLeg[i]].baseOffset + glm::vec3(dist(rng), dist(rng), dist(rng));
+    }
+    long rejected = 0, maybeSolved = 0, wrong = 0;
+    for (int i = 0; i < numTargets; i++) {
+        float angles[3];
+        bool maybe = workspace.mayReach(targetLeg[i], targets[i]);
+        bool solved = solveLegIK(model, targetLeg[i], targets[i], angles) == IK_SOLVED;
+        if (!maybe) rejected++;
+        if (maybe && solved) maybeSolved++;
+        if (!maybe && solved) wrong++;
+    }
+    printf("targets: %d, %ld ruled out, %ld of the other %ld solvable\n", numTargets, rejected, maybeSolved, numTargets - rejected);
+    printf("ruled out but solvable: %ld\n", wrong);
+
+    // timing: the lookup against the IK it's there to skip
+    const int iterations = 20;
+    long checksum = 0;
+    start = benchClock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < numTargets; i++) checksum += workspace.mayReach(targetLeg[i], targets[i]);
+    }
+    double lookupSeconds = secondsSince(start);
+    float angleSum = 0.0f;
+    start = benchClock::now();
+    for (int i = 0; i < numTargets; i++) {
+        float angles[3] = {0.0f, 0.0f, 0.0f};
+        solveLegIK(model, targetLeg[i], targets[i], angles);
+        angleSum += angles[0];
+    }
+    double ikSeconds = secondsSince(start);
+    printf("lookup:       %.1f ns\n", lookupSeconds * 1e9 / ((double)iterations * numTargets));
+    printf("solveLegIK:   %.1f ns\n", ikSeconds * 1e9 / numTargets);
+    printf("checksum:     %ld %.3f\n", checksum, angleSum);
+
+    long reloadMismatches = 0;
+    if (path) {
+        LegWorkspace loaded(model);
+        if (!workspace.save(path) || !loaded.load(path)) {
+            return 1;
+        }
+        for (int i = 0; i < numTargets; i++) {
+            if (loaded.mayReach(targetLeg[i], targets[i]) != workspace.mayReach(targetLeg[i], targets[i])) reloadMismatches++;
+        }
+        printf("saved to %s, %ld mismatches after loading it back\n", path, reloadMismatches);
+    }
+
+    return (wrong == 0 && reloadMismatches == 0) ? 0 : 1;
+}
+
+static int runFixedStep(int argc, char** argv) {
+    int numRobots = 20;
+    double duration = 5.0;
+    if (argc > 0) numRobots = atoi(argv[0]);
+    if (argc > 1) duration = atof(argv[1]);
+    if (numRobots <= 0 || duration <= 0.0) {
+        printf("usage: headless fixedstep [robots] [seconds]\n");
+        return 1;
+    }
+
+    // uneven frames handed to FixedStep, with the guard set high enough to never drop: after every frame the
+    // steps run so far have to be the whole steps in the time passed, with less than a step left over
+    const float dt = 1.0f / 240.0f;
+    Simulation framed(GAIT_TRIPOD, numRobots);
+    FixedStep stepper(dt, 1000);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> frameTime(0.0, 0.05); // up to 20 fps, often several steps a frame
+    double totalTime = 0.0;
+    long stepsRun = 0, frames = 0, badFrames = 0;
+    while (totalTime < duration) {
+        double elapsed = frameTime(rng);
+        totalTime += elapsed;
+        int steps = stepper.advance(elapsed);
+        for (int i = 0; i < steps; i++) framed.step(dt);
+        stepsRun += steps;
+        frames++;
+        double leftover = stepper.leftover();
+        if (stepsRun != (long)floor(totalTime / stepper.dt) || leftover < 0.0 || leftover >= stepper.dt) {
+            badFrames++;
+        }
+    }
+    printf("%ld steps over %ld uneven frames (%.4f s), frames with the wrong step count or leftover: %ld\n",
+           stepsRun, frames, totalTime, badFrames);
+
+    // the same number of steps taken straight has to land on the same state to the bit
+    Simulation straight(GAIT_TRIPOD, numRobots);
+    for (long i = 0; i < stepsRun; i++) straight.step(dt);
+    long differing = 0;
+    for (int r = 0; r < numRobots; r++) {
+        glm::mat4 a = straight.bodyTransform(r), b = framed.bodyTransform(r);
+        if (memcmp(&a, &b, sizeof(a)) != 0) differing++;
+    }
+    printf("robots differing from stepping straight: %ld\n", differing);
+
+    // a one second hitch at the default guard runs 8 steps and lets the rest go
+    FixedStep guarded(dt);
+    int hitchSteps = guarded.advance(1.0);
+    printf("after a 1 s hitch: %d steps run, %ld dropped, %.4f s left over\n", hitchSteps, guarded.droppedSteps, guarded.leftover());
+    bool guardOk = hitchSteps == guarded.maxSteps && guarded.droppedSteps + hitchSteps == (long)(1.0 / guarded.dt) && guarded.leftover() < dt;
+
+    // blending two real states lands exactly on them at the ends
+    std::vector<shapeInstance> previous(straight.shapeCount()), current(straight.shapeCount()), blended(straight.shapeCount());
+    straight.writeInstances(previous.data(), previous.size());
+    straight.step(dt);
+    int count = straight.writeInstances(current.data(), current.size());
+    float endError = 0.0f;
+    for (int i = 0; i < count; i++) {
+        for (int end = 0; end < 2; end++) {
+            interpolateShapeInstance(blended[i], previous[i], current[i], (float)end);
+            const glm::mat4& expected = end ? current[i].model : previous[i].model;
+            for (int col = 0; col < 4; col++) {
+                endError = glm::max(endError, glm::length(blended[i].model[col] - expected[col]));
+            }
+        }
+    }
+
+    // and in between. blending matrices instead of poses bends a turning box slightly off the true rotation
+    // and skews its columns off square, both growing with how far it turns in one step. 0.1 rad a step is a
+    // leg joint at about 24 rad/s at 240 Hz and has to stay close; 1 rad is only reported, for what a much
+    // lower sim rate would look like
+    glm::vec3 dimensions(3.0f, 1.0f, 1.0f), axis = glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f));
+    float midError[2] = {0.0f, 0.0f}, shrink[2] = {0.0f, 0.0f}, shear[2] = {0.0f, 0.0f};
+    const float stepAngles[2] = {0.1f, 1.0f};
+    for (int n = 0; n < 2; n++) {
+        shapeInstance a, b, mid;
+        writeShapeInstance(a, glm::mat4(1.0f), dimensions, glm::vec3(1.0f));
+        writeShapeInstance(b, glm::rotate(glm::mat4(1.0f), stepAngles[n], axis), dimensions, glm::vec3(1.0f));
+        for (int k = 0; k <= 10; k++) {
+            float t = k / 10.0f;
+            interpolateShapeInstance(mid, a, b, t);
+            shapeInstance exact;
+            writeShapeInstance(exact, glm::rotate(glm::mat4(1.0f), stepAngles[n] * t, axis), dimensions, glm::vec3(1.0f));
+            for (int col = 0; col < 3; col++) {
+                midError[n] = glm::max(midError[n], glm::length(mid.model[col] - exact.model[col]));
+                shrink[n] = glm::max(shrink[n], glm::abs(glm::length(mid.model[col]) - dimensions[col]));
+                // degrees the columns are off from square
+                glm::vec3 u = glm::normalize(glm::vec3(mid.model[col])), v = glm::normalize(glm::vec3(mid.model[(col + 1) % 3]));
+                shear[n] = glm::max(shear[n], glm::degrees(asinf(glm::min(glm::abs(glm::dot(u, v)), 1.0f))));
+            }
+        }
+    }
+    printf("blend at the ends vs the states: %g\n", endError);
+    for (int n = 0; n < 2; n++) {
+        printf("blend in between, %.1f rad a step: off the rotation by %g, length change %g, shear %.3f degrees\n",
+               stepAngles[n], midError[n], shrink[n], shear[n]);
+    }
+
+    return (badFrames == 0 && differing == 0 && guardOk && endError < 1e-5f && midError[0] < 2e-3f && shrink[0] < 1e-5f
+            && shear[0] < 0.5f) ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "fixedstep") == 0) {
+        return runFixedStep(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "workspace") == 0) {
+        return runWorkspace(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "selfcollide") == 0) {
+        return runSelfCollide(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "contact") == 0) {
+        return runContact(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "dynamics") == 0) {
+        return runDynamics(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "triple") == 0) {
+        return runTriple(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "static") == 0) {
+        return runStatic(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "ik") == 0) {
+        return runIK(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "fk") == 0) {
+        return runFK(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "sim") == 0) {
+        return runSim(argc - 2, argv + 2);
+    }
+    return runSim(argc - 1, argv + 1);
+}
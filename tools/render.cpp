@@ -0,0 +1,293 @@
+// offscreen renderer. draws the simulation into a framebuffer object with no window or display, through an
+// EGL surfaceless context (mesa llvmpipe works), and writes every frame out as a binary ppm image.
+// meant for rendering gait regression videos on build machines; run it from the repo root so it finds
+// the shaders
+//
+// usage: render [frames] [robots] [outdir] [width] [height]
+//
+// frames are stepped at 30 fps. pixels are read back through a ring of pixel buffer objects, so
+// glReadPixels only queues a copy and the frame is mapped and saved a couple of frames later, once the
+// gpu has finished with it, instead of stalling the pipeline every frame. string them together with
+// something like: ffmpeg -framerate 30 -i out/frame_%04d.ppm gait.mp4
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "../Shader.hpp"
+#include "../Camera.hpp"
+#include "../Renderer.hpp"
+#include "../GeometryRegistry.hpp"
+#include "../InstanceRenderer.hpp"
+#include "../Culling.hpp"
+#include "../RenderQueue.hpp"
+#include "../Simulation.cpp"
+
+typedef std::chrono::steady_clock benchClock;
+
+static double secondsSince(benchClock::time_point start) {
+    return std::chrono::duration<double>(benchClock::now() - start).count();
+}
+
+// a gl 3.3 core context with no surface at all, everything goes to our own framebuffer
+static bool createContext(EGLDisplay* displayOut, EGLContext* contextOut) {
+    // mesa's surfaceless platform needs no display server. fall back to the default display elsewhere
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        printf("failed to initialize EGL\n");
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        printf("EGL has no desktop OpenGL\n");
+        return false;
+    }
+    EGLint configAttribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config = NULL;
+    EGLint numConfigs = 0;
+    eglChooseConfig(display, configAttribs, &config, 1, &numConfigs);
+
+    EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, numConfigs > 0 ? config : NULL, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        printf("failed to create a surfaceless OpenGL 3.3 context (EGL error 0x%x)\n", eglGetError());
+        return false;
+    }
+
+    *displayOut = display;
+    *contextOut = context;
+    return true;
+}
+
+static bool writePPM(const std::string& path, const unsigned char* rgba, int width, int height) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        printf("couldn't write %s\n", path.c_str());
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> row(width * 3);
+    for (int y = height - 1; y >= 0; y--) { // gl's rows start at the bottom
+        const unsigned char* src = rgba + (size_t)y * width * 4;
+        for (int x = 0; x < width; x++) {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int numFrames = 60;
+    int numRobots = 1;
+    std::string outDir = ".";
+    int width = 800, height = 600;
+    if (argc > 1) numFrames = atoi(argv[1]);
+    if (argc > 2) numRobots = atoi(argv[2]);
+    if (argc > 3) outDir = argv[3];
+    if (argc > 4) width = atoi(argv[4]);
+    if (argc > 5) height = atoi(argv[5]);
+    if (numFrames <= 0 || numRobots <= 0 || width <= 0 || height <= 0) {
+        printf("usage: render [frames] [robots] [outdir] [width] [height]\n");
+        return 1;
+    }
+    const float dt = 1.0f / 30.0f;
+
+    EGLDisplay display;
+    EGLContext context;
+    if (!createContext(&display, &context)) {
+        return 1;
+    }
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        printf("failed to initialize GLAD\n");
+        return 1;
+    }
+    bool persistent = loadStreamBufferExtensions((GLADloadproc)eglGetProcAddress);
+    printf("renderer:     %s\n", glGetString(GL_RENDERER));
+    printf("instances:    %s\n", persistent ? "persistent mapped ring" : "unsynchronized mapped ring");
+
+    // color and depth renderbuffers in place of a window
+    unsigned int FBO, colorRBO, depthRBO;
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glGenRenderbuffers(1, &colorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+    glGenRenderbuffers(1, &depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        printf("framebuffer incomplete\n");
+        return 1;
+    }
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+
+    // same scene setup as app.cpp
+    Shader lightingShader("shaders/shader.vs", "shaders/shader.fs");
+    GeometryRegistry geometry;
+    int boxMesh = geometry.addMesh(buildBoxMesh());
+    geometry.upload();
+
+    RenderQueue renderQueue;
+    int shapeMaterial = renderQueue.addMaterial({32.0f});
+
+    UniformBlock<frameBlock> frameUniforms(UBO_FRAME);
+    UniformBlock<lightBlock> lightUniforms(UBO_LIGHT);
+    lightBlock light = {};
+    light.ambient = glm::vec3(0.2f);
+    light.diffuse = glm::vec3(0.5f);
+    light.specular = glm::vec3(1.0f);
+    light.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    lightUniforms.set(light);
+
+    Simulation worldSim(GAIT_TRIPOD, numRobots);
+    InstanceRenderer shapeRenderer(geometry, worldSim.shapeCount());
+
+    // where app.cpp starts for one robot, and up and back far enough to see the whole field for more
+    Camera camera(glm::vec3(0.0f, 2.0f, 22.0f));
+    if (numRobots > 1) {
+        float fieldSize = glm::ceil(glm::sqrt((float)numRobots)) * worldSim.robotSpacing;
+        camera = Camera(glm::vec3(0.0f, 0.6f * fieldSize, 0.9f * fieldSize + 22.0f), glm::vec3(0.0f, 1.0f, 0.0f), YAW, -30.0f);
+    }
+    frameBlock frame = {};
+    frame.projection = glm::perspective(glm::radians(camera.Zoom), (float)width / (float)height, 0.1f, 1000.0f);
+    frame.view = camera.GetViewMatrix();
+    frame.viewPos = camera.Position;
+    frameUniforms.set(frame);
+    frustumPlanes frustum = extractFrustum(frame.projection * frame.view);
+
+    // every shape this frame, culled down to the visible ones on the way into the instance buffer
+    std::vector<shapeInstance> instances(worldSim.shapeCount());
+    ShapeBVH shapeBounds;
+    long visibleShapes = 0;
+    int cullMismatches = 0;
+
+    // readback ring. frame i is copied into pbo i % N and saved N - 1 frames later
+    const int numPBOs = 3;
+    size_t frameBytes = (size_t)width * height * 4;
+    unsigned int PBOs[numPBOs];
+    glGenBuffers(numPBOs, PBOs);
+    for (int i = 0; i < numPBOs; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, PBOs[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    double waitSeconds = 0.0;
+    int framesWritten = 0;
+    bool ok = true;
+    // maps the oldest pending copy and writes it out
+    auto saveFrame = [&](int frameIndex) {
+        auto waitStart = benchClock::now();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, PBOs[frameIndex % numPBOs]);
+        const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+        waitSeconds += secondsSince(waitStart);
+        if (pixels) {
+            char name[64];
+            snprintf(name, sizeof(name), "/frame_%04d.ppm", frameIndex);
+            ok = writePPM(outDir + name, pixels, width, height) && ok;
+            framesWritten++;
+        } else {
+            ok = false;
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    };
+
+    auto start = benchClock::now();
+    for (int f = 0; f < numFrames; f++) {
+        worldSim.step(dt);
+        int numShapes = worldSim.writeInstances(instances.data(), instances.size());
+        shapeBounds.update(instances.data(), numShapes);
+        int numVisible = shapeBounds.cull(frustum, instances.data(), shapeRenderer.beginInstances());
+        shapeRenderer.endInstances(numVisible);
+        visibleShapes += numVisible;
+
+        // the tree should keep exactly the shapes that testing every one of them would
+        int expected = 0;
+        for (int i = 0; i < numShapes; i++) {
+            glm::vec3 center, extent;
+            instanceBounds(instances[i], center, extent);
+            expected += testBox(frustum, center, extent) != CULL_OUTSIDE;
+        }
+        cullMismatches += numVisible != expected;
+
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderQueue.add(lightingShader, boxMesh, shapeMaterial, 0.0f);
+        renderQueue.submit(shapeRenderer);
+        shapeRenderer.endFrame();
+
+        // with a pack buffer bound, glReadPixels just queues a copy into it and returns
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, PBOs[f % numPBOs]);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glFlush();
+
+        if (f >= numPBOs - 1) {
+            saveFrame(f - (numPBOs - 1));
+        }
+    }
+    for (int f = glm::max(0, numFrames - (numPBOs - 1)); f < numFrames; f++) {
+        saveFrame(f); // the ones still in flight
+    }
+    double seconds = secondsSince(start);
+
+    GLenum error = glGetError();
+    printf("frames:       %d of %d written to %s (%dx%d, %d robots, %d shapes)\n", framesWritten, numFrames,
+           outDir.c_str(), width, height, numRobots, shapeRenderer.capacity());
+    printf("wall time:    %.3f s (%.1f frames/sec)\n", seconds, numFrames / seconds);
+    printf("map wait:     %.3f s\n", waitSeconds);
+    printf("instance stalls: %ld\n", shapeRenderer.stalls());
+    printf("visible:      %.1f of %d shapes per frame (last frame: %d nodes visited, %d boxes tested)\n",
+           (double)visibleShapes / glm::max(numFrames, 1), shapeRenderer.capacity(), shapeBounds.nodesVisited,
+           shapeBounds.boxesTested);
+    printf("state binds:  %ld issued, %ld skipped as redundant\n", GLState::issued, GLState::skipped);
+    if (cullMismatches) {
+        printf("culling disagreed with testing every shape on %d frames\n", cullMismatches);
+        ok = false;
+    }
+    if (error != GL_NO_ERROR) {
+        printf("gl error 0x%x\n", error);
+        ok = false;
+    }
+
+    glDeleteBuffers(numPBOs, PBOs);
+    shapeRenderer.release();
+    frameUniforms.release();
+    lightUniforms.release();
+    geometry.release();
+    glDeleteRenderbuffers(1, &colorRBO);
+    glDeleteRenderbuffers(1, &depthRBO);
+    glDeleteFramebuffers(1, &FBO);
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    return ok ? 0 : 1;
+}